@@ -32,16 +32,15 @@ void sensirion_i2c_release(void)
     // TODO: Implement function
 }
 
+// I2C1 errors are returned negated, so they never look like NO_ERROR
 int8_t sensirion_i2c_read(uint8_t address, uint8_t* data, uint16_t count)
 {
-    I2C1_Read(address, count, data);
-    return 0;
+    return -(int8_t)I2C1_Read(address, count, data);
 }
 
 int8_t sensirion_i2c_write(uint8_t address, const uint8_t* data, uint16_t count)
 {
-    I2C1_Write(address, count, data);
-    return 0;
+    return -(int8_t)I2C1_Write(address, count, (uint8_t *)data);
 }
 
 void sensirion_sleep_usec(uint32_t useconds)
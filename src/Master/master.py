@@ -62,6 +62,19 @@ class Master:
             print(f"Error reading {name} (option {option}): {e}")
             return 0 if isinstance(option, int) else None
 
+    def read_station_snapshot(self) -> Any:
+        """
+        Fetch the whole station register map in one round trip.
+
+        :return: List of register values or None on error.
+        """
+        try:
+            return sensors.read_input_registers(self.serial_port, sensors.STATION_ADDRESS,
+                                                0x0000, sensors.STATION_REGISTER_COUNT)
+        except Exception as e:
+            print(f"Error reading station snapshot: {e}")
+            return None
+
     def __enter__(self):
         self.connect()
         return self
@@ -1,9 +1,20 @@
-import time
 import serial
 import math
+import time
 
 # Defined constant for ADC conversion
-ADC_STEP_SIZE_U = 3.3 / 4095
+ADC_STEP_SIZE_U = 3.3 / 4096  # Same as ADC_STEP_SIZE_U in adc.h
+
+# Station-wide input register map (see modbus_map.h)
+STATION_ADDRESS = 0x10
+STATION_REGISTER_COUNT = 0x50
+
+# Time the station may take to start answering a request
+RESPONSE_TIMEOUT_S = 0.1
+
+# Resends after a request got no answer. A station in Stop mode loses the
+# first frame that wakes it, so one resend is always needed after idle time.
+REQUEST_RETRIES = 2
 
 
 def modbus_crc(data: bytearray) -> bytearray:
@@ -28,6 +39,79 @@ def modbus_crc(data: bytearray) -> bytearray:
     return bytearray([(crc >> 8) & 0xFF, crc & 0xFF])
 
 
+def character_time(serial_port: serial.Serial) -> float:
+    """
+    Time one character takes on the line with the port's framing.
+
+    Args:
+        serial_port (serial.Serial): Serial connection to the station.
+
+    Returns:
+        float: Character time in seconds.
+    """
+    bits = 1 + serial_port.bytesize + serial_port.stopbits
+    if serial_port.parity != serial.PARITY_NONE:
+        bits += 1
+    return bits / serial_port.baudrate
+
+
+def read_response(serial_port: serial.Serial, expected_length: int) -> bytearray:
+    """
+    Read a response frame of known length.
+
+    The deadline covers the station's turnaround, the time the whole frame
+    takes on the line and the closing t3.5 silence, so long replies are not
+    cut short by the port timeout. An exception response ends the read early.
+
+    Args:
+        serial_port (serial.Serial): Serial connection to the station.
+        expected_length (int): Length of a complete normal response.
+
+    Returns:
+        bytearray: The bytes received, possibly fewer than expected_length.
+    """
+    char_time = character_time(serial_port)
+    deadline = time.monotonic() + RESPONSE_TIMEOUT_S + (expected_length + 3.5) * char_time
+    response = bytearray()
+
+    while len(response) < expected_length and time.monotonic() < deadline:
+        response.extend(serial_port.read(expected_length - len(response)))
+        if len(response) >= 5 and response[1] & 0x80:
+            break
+
+    return response
+
+
+def transact(serial_port: serial.Serial, frame: bytearray, expected_length: int) -> bytearray:
+    """
+    Send a request and read its response, resending it when no answer comes.
+
+    Only a timed out request is resent, at most REQUEST_RETRIES times. Bytes
+    left over from a broken answer are discarded before each resend.
+
+    Args:
+        serial_port (serial.Serial): Serial connection to the station.
+        frame (bytearray): Complete request frame including the CRC.
+        expected_length (int): Length of a complete normal response.
+
+    Returns:
+        bytearray: The bytes of the last attempt, possibly fewer than expected_length.
+    """
+    if not serial_port.is_open:
+        serial_port.open()
+
+    for attempt in range(REQUEST_RETRIES + 1):
+        if attempt > 0:
+            serial_port.reset_input_buffer()
+        serial_port.write(frame)
+
+        response = read_response(serial_port, expected_length)
+        if len(response) >= expected_length or (len(response) >= 5 and response[1] & 0x80):
+            break
+
+    return response
+
+
 def build_modbus_request(address: int, register: int, count: int) -> bytearray:
     """
     Build a dynamic Modbus request frame.
@@ -47,6 +131,60 @@ def build_modbus_request(address: int, register: int, count: int) -> bytearray:
     return frame
 
 
+def read_input_registers(serial_port: serial.Serial, address: int, register: int, count: int) -> list:
+    """
+    Read a block of input registers in a single transaction.
+
+    Args:
+        serial_port (serial.Serial): Serial connection to the station.
+        address (int): The Modbus address to query.
+        register (int): First register to read.
+        count (int): Number of registers to read (max 125).
+
+    Returns:
+        list: The register values as unsigned 16-bit integers.
+
+    Raises:
+        ValueError: On an exception response or an incomplete frame.
+    """
+    expected_length = 5 + 2 * count
+    response = transact(serial_port, build_modbus_request(address, register, count), expected_length)
+    if len(response) >= 5 and response[1] & 0x80:
+        raise ValueError(f"Station answered with exception code {response[2]:#04x}.")
+    if len(response) < expected_length:
+        raise ValueError("Received incomplete data frame from station.")
+
+    return [(response[3 + 2 * i] << 8) | response[4 + 2 * i] for i in range(count)]
+
+
+def write_holding_registers(serial_port: serial.Serial, address: int, register: int, values: list) -> None:
+    """
+    Write a block of holding registers (function 0x10) to change the station configuration.
+
+    Args:
+        serial_port (serial.Serial): Serial connection to the station.
+        address (int): The Modbus address to write to.
+        register (int): First register to write.
+        values (list): Unsigned 16-bit values to write (max 123).
+
+    Raises:
+        ValueError: On an exception response or an incomplete frame.
+    """
+    frame = bytearray([address, 0x10,
+                       (register >> 8) & 0xFF, register & 0xFF,
+                       (len(values) >> 8) & 0xFF, len(values) & 0xFF,
+                       2 * len(values)])
+    for value in values:
+        frame.extend([(value >> 8) & 0xFF, value & 0xFF])
+    frame.extend(modbus_crc(frame))
+
+    response = transact(serial_port, frame, 8)
+    if len(response) >= 5 and response[1] & 0x80:
+        raise ValueError(f"Station answered with exception code {response[2]:#04x}.")
+    if len(response) < 8:
+        raise ValueError("Received incomplete data frame from station.")
+
+
 class Sensor:
     """
     Base sensor class with a generic method for reading sensor data.
@@ -74,17 +212,13 @@ class Sensor:
         Raises:
             ValueError: If the raw data frame is not of the expected length.
         """
-        if not serial_port.is_open:
-            serial_port.open()
-
-        serial_port.write(request_frame)
         # Print the frame with 2 bytes at a time for debugging
         print("Request Frame: ", end='')
         for i in range(0, len(request_frame), 2):
             print(f"{request_frame[i]:02X} {request_frame[i+1]:02X}", end=' ')
         print()
 
-        raw_value = bytearray(serial_port.read(7))
+        raw_value = transact(serial_port, request_frame, 7)
         if len(raw_value) < 5:
             raise ValueError("Received incomplete data frame from sensor.")
         return convert_method(raw_value)
@@ -138,12 +272,12 @@ class DHT22(Sensor):
     """
     Temperature and humidity sensor DHT22.
 
-    Enforces a minimum delay between consecutive readings.
+    The station converts at most every 2 s and serves both channels from the
+    same cached conversion, so no delay is needed between reads.
     """
 
     def __init__(self, address: int, name: str):
         super().__init__(address, name)
-        self.last_read_time: float = 0.0
         self.channels = 2  # Option 0: Humidity, Option 1: Temperature
         self.units = {0: "%", 1: "°C"}  # Humidity in %, Temperature in °C
         self.channel_names = {0: "Relative Humidity", 1: "Temperature"}
@@ -154,25 +288,18 @@ class DHT22(Sensor):
 
         Args:
             serial_port (serial.Serial): Serial connection.
-            option (int): 0 for temperature, 1 for humidity.
+            option (int): 0 for humidity, 1 for temperature.
 
         Returns:
             float: Converted sensor reading.
         """
-        # Ensure at least a 0.5s pause between consecutive reads
-        elapsed_time = time.time() - self.last_read_time
-        if elapsed_time < 0.5:
-            time.sleep(0.5 - elapsed_time)
-
-        # For DHT22, assume register 0x0001 is for temperature and 0x0002 for humidity.
+        # Register 0x0001 is humidity and 0x0002 temperature of the same conversion.
         if option == 0:
             request_frame = build_modbus_request(self.address, 0x01, 1)
         else:
             request_frame = build_modbus_request(self.address, 0x02, 1)
 
-        value = self.read_sensor(serial_port, request_frame, self.convert)
-        self.last_read_time = time.time()
-        return value
+        return self.read_sensor(serial_port, request_frame, self.convert)
 
     @staticmethod
     def convert(modbus_frame: bytearray) -> float:
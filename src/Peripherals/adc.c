@@ -7,14 +7,166 @@
 
 #include "stm32l1xx.h"
 #include "adc.h"
+#include "oversample.h"
+#include "convert.h"
+
+static volatile uint16_t adc_dma[ADC_DMA_SCANS * ADC_SCAN_CHANNELS];
+static volatile uint16_t adc_latest[ADC_SCAN_CHANNELS];
+static OVERSAMPLE_Channel adc_oversample[ADC_SCAN_CHANNELS];
 
 // This function needs to be called before using sensors!
+// TIM6 must be running, its update event triggers the scans.
 void ADC_init()
 {
 	RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+	ADC->CCR |= ADC_CCR_TSVREFE; // Internal temperature sensor and VREFINT on ADC_IN16/17
 
-	ADC1->CR2 &= ~ADC_CR2_CONT; // Single conversion mode
-	ADC1->SMPR3 |= ADC_SMPR3_SMP0; // 384 bit conversion rate
+	ADC1->CR2 &= ~ADC_CR2_CONT; // Single scan per trigger
 	ADC1->CR1 &= ~ADC_CR1_RES; // 12-Bit Resolution
-	ADC1->SQR5 &= ~ADC_SQR5_SQ1; // Start at channel zero
+	ADC1->CR1 |= ADC_CR1_SCAN;
+	ADC1->SMPR3 |= ADC_SMPR3_SMP0 | ADC_SMPR3_SMP1; // 384 cycles
+	ADC1->SMPR2 |= ADC_SMPR2_SMP16 | ADC_SMPR2_SMP17; // 384 cycles, internal channels need > 4 us. p.297
+
+	for (int i = 0; i < ADC_SCAN_CHANNELS; ++i)
+	{
+		OVERSAMPLE_Init(&adc_oversample[i], ADC_OVERSAMPLING_INTERNAL);
+	}
+
+	ADC1->SQR1 = (ADC_SCAN_CHANNELS - 1) << ADC_SQR1_L_Pos;
+	ADC1->SQR5 = (0 << ADC_SQR5_SQ1_Pos)
+			| (1 << ADC_SQR5_SQ2_Pos)
+			| (ADC_CHANNEL_TEMPSENSOR << ADC_SQR5_SQ3_Pos)
+			| (ADC_CHANNEL_VREFINT << ADC_SQR5_SQ4_Pos);
+
+	// DMA1 channel 1 = ADC1, circular, 16-bit, memory increment,
+	// half and full transfer interrupts. p.251
+	DMA1_Channel1->CCR = 0;
+	DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+	DMA1_Channel1->CMAR = (uint32_t)adc_dma;
+	DMA1_Channel1->CNDTR = ADC_DMA_SCANS * ADC_SCAN_CHANNELS;
+	DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_HTIE | DMA_CCR_TCIE;
+	DMA1_Channel1->CCR |= DMA_CCR_EN;
+	NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+	// DMA requests for every scan, rising edge of TIM6_TRGO (EXTSEL 1010). p.303
+	ADC1->CR2 |= ADC_CR2_DMA | ADC_CR2_DDS;
+	ADC1->CR2 &= ~(ADC_CR2_EXTSEL | ADC_CR2_EXTEN);
+	ADC1->CR2 |= ADC_CR2_EXTSEL_3 | ADC_CR2_EXTSEL_1 | ADC_CR2_EXTEN_0;
+
+	ADC1->CR2 |= ADC_CR2_ADON;
+	while (!(ADC1->SR & ADC_SR_ADONS)){}
+}
+
+/*
+ * Before Stop mode. An enabled ADC and the temperature sensor / VREFINT
+ * buffer keep drawing current even with no conversion running.
+ * The DMA stops too, a scan cut short by ADON would shift the ranks.
+ */
+void ADC_Suspend()
+{
+	ADC1->CR2 &= ~ADC_CR2_ADON;
+	ADC->CCR &= ~ADC_CCR_TSVREFE;
+
+	DMA1_Channel1->CCR &= ~DMA_CCR_EN;
+	DMA1->IFCR = DMA_IFCR_CGIF1;
+	NVIC_ClearPendingIRQ(DMA1_Channel1_IRQn);
+}
+
+// After Stop mode, once the HSI runs again. The DMA restarts at the first
+// scan, the next TIM6 trigger converts all ranks into it.
+void ADC_Resume()
+{
+	DMA1_Channel1->CNDTR = ADC_DMA_SCANS * ADC_SCAN_CHANNELS;
+	DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+	ADC->CCR |= ADC_CCR_TSVREFE;
+	ADC1->CR2 |= ADC_CR2_ADON;
+	while (!(ADC1->SR & ADC_SR_ADONS)){}
+}
+
+// Sample time code for PA0 and PA1, 0 = 4 cycles ... 7 = 384 cycles. p.297
+void ADC_SetSampleTime(uint8_t code)
+{
+	ADC1->SMPR3 &= ~(ADC_SMPR3_SMP0 | ADC_SMPR3_SMP1);
+	ADC1->SMPR3 |= (code << ADC_SMPR3_SMP0_Pos) | (code << ADC_SMPR3_SMP1_Pos);
+}
+
+// log2 of the samples per decimated result of one scan rank, restarts its block
+void ADC_SetOversampling(uint8_t index, uint8_t log2)
+{
+	if (log2 == adc_oversample[index].log2)
+	{
+		return;
+	}
+
+	NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+	OVERSAMPLE_Init(&adc_oversample[index], log2);
+	NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+}
+
+static void ADC_ProcessScans(uint16_t first_scan)
+{
+	for (uint16_t scan = first_scan; scan < first_scan + ADC_DMA_SCANS / 2; ++scan)
+	{
+		for (uint8_t i = 0; i < ADC_SCAN_CHANNELS; ++i)
+		{
+			uint16_t sample = adc_dma[scan * ADC_SCAN_CHANNELS + i];
+
+			OVERSAMPLE_Add(&adc_oversample[i], sample);
+			adc_latest[i] = sample;
+		}
+	}
+}
+
+// DMA1 channel 1 interrupt, one half of the buffer is complete and stays
+// untouched for the next ADC_DMA_SCANS / 2 scans.
+void ADC_DMAHandler()
+{
+	if (DMA1->ISR & DMA_ISR_HTIF1)
+	{
+		DMA1->IFCR = DMA_IFCR_CHTIF1;
+		ADC_ProcessScans(0);
+	}
+
+	if (DMA1->ISR & DMA_ISR_TCIF1)
+	{
+		DMA1->IFCR = DMA_IFCR_CTCIF1;
+		ADC_ProcessScans(ADC_DMA_SCANS / 2);
+	}
+}
+
+// Latest conversion of one scan rank (ADC_SCAN_*)
+uint16_t ADC_GetSample(uint8_t index)
+{
+	return adc_latest[index];
+}
+
+// Latest decimated value on a 16-bit scale, 0 until the first block is done
+uint16_t ADC_GetOversampled(uint8_t index)
+{
+	return adc_oversample[index].result;
+}
+
+uint8_t ADC_OversampledReady(uint8_t index)
+{
+	return adc_oversample[index].ready;
+}
+
+// VDDA in mV from VREFINT, nominal until the first VREFINT block is ready
+uint16_t ADC_GetVdda()
+{
+	if (!ADC_OversampledReady(ADC_SCAN_VREFINT))
+	{
+		return CONVERT_VDDA_NOMINAL_MV;
+	}
+
+	return CONVERT_Vdda(ADC_VREFINT_CAL, ADC_GetOversampled(ADC_SCAN_VREFINT));
+}
+
+// Die temperature in 0.01 C
+int16_t ADC_GetMcuTemperature()
+{
+	return CONVERT_McuTemperature(ADC_TS_CAL1, ADC_TS_CAL2, ADC_GetOversampled(ADC_SCAN_TEMPSENSOR), ADC_GetVdda());
 }
@@ -8,11 +8,47 @@
 #ifndef PERIPHERALS_ADC_H_
 #define PERIPHERALS_ADC_H_
 
+#include <stdint.h>
+
 #define ADC_MAX 4096
 #define ADC_STEP_SIZE_U 0.000805664f // 3.3V / 4096
 
 #define CHANNEL_MASK 0x1F
 
+/*
+ * The ADC scans all analog inputs on every TIM6 update (1 kHz) and DMA1
+ * channel 1 streams the results into a circular buffer of ADC_DMA_SCANS
+ * scans. The half and full transfer interrupts feed each half into the
+ * per-channel oversamplers. ADC_GetSample() gives the latest 12-bit value,
+ * ADC_GetOversampled() the latest decimated one on a 16-bit scale.
+ */
+#define ADC_SCAN_LMT84LP 0 // PA0, ADC_IN0
+#define ADC_SCAN_NSL19M51 1 // PA1, ADC_IN1
+#define ADC_SCAN_TEMPSENSOR 2 // ADC_IN16
+#define ADC_SCAN_VREFINT 3 // ADC_IN17
+#define ADC_SCAN_CHANNELS 4
+
+#define ADC_DMA_SCANS 8 // Interrupt every 4 scans
+#define ADC_OVERSAMPLING_INTERNAL 4 // log2 ratio for VREFINT and the temperature sensor
+
+// Factory calibration, measured at VDDA = 3.0 V and 30 / 110 C (STM32L152RE datasheet, p.98)
+#define ADC_VREFINT_CAL (*(const uint16_t *)0x1FF800F8)
+#define ADC_TS_CAL1 (*(const uint16_t *)0x1FF800FA)
+#define ADC_TS_CAL2 (*(const uint16_t *)0x1FF800FE)
+
+#define ADC_CHANNEL_TEMPSENSOR 16
+#define ADC_CHANNEL_VREFINT 17
+
 void ADC_init();
+void ADC_SetSampleTime(uint8_t code);
+void ADC_SetOversampling(uint8_t index, uint8_t log2);
+void ADC_DMAHandler();
+uint16_t ADC_GetSample(uint8_t index);
+uint16_t ADC_GetOversampled(uint8_t index);
+uint8_t ADC_OversampledReady(uint8_t index);
+uint16_t ADC_GetVdda();
+int16_t ADC_GetMcuTemperature();
+void ADC_Suspend();
+void ADC_Resume();
 
 #endif /* PERIPHERALS_ADC_H_ */
@@ -0,0 +1,162 @@
+/*
+ * clock.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "clock.h"
+#include "timing.h"
+#include "timers.h"
+#include "usart.h"
+#include "i2c.h"
+#include "modbus.h"
+#include "sampler.h"
+#include "dht22.h"
+
+static CLOCK_Mode clock_mode = CLOCK_HIGH;
+
+// Call after SetSysClock(), the station boots on the PLL
+void CLOCK_init()
+{
+	clock_mode = CLOCK_HIGH;
+}
+
+CLOCK_Mode CLOCK_GetMode()
+{
+	return clock_mode;
+}
+
+uint32_t CLOCK_GetPclk1Hz()
+{
+	return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+}
+
+uint32_t CLOCK_GetPclk2Hz()
+{
+	return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+}
+
+// Bits 12:11 VOS[1:0], waits until the regulator has settled. p.121
+static void CLOCK_SetVoltageRange(uint32_t vos)
+{
+	PWR->CR = (PWR->CR & ~PWR_CR_VOS) | vos;
+	while (PWR->CSR & PWR_CSR_VOSF){}
+}
+
+static void CLOCK_SwitchToPLL()
+{
+	RCC->CR |= RCC_CR_HSION;
+	while (!(RCC->CR & RCC_CR_HSIRDY)){}
+
+	RCC->CR |= RCC_CR_PLLON;
+	while (!(RCC->CR & RCC_CR_PLLRDY)){}
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_PLL;
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL){}
+}
+
+static void CLOCK_SwitchToMSI()
+{
+	RCC->ICSCR = (RCC->ICSCR & ~RCC_ICSCR_MSIRANGE) | CLOCK_LOW_MSI_RANGE;
+	RCC->CR |= RCC_CR_MSION;
+	while (!(RCC->CR & RCC_CR_MSIRDY)){}
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | RCC_CFGR_SW_MSI;
+	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_MSI){}
+
+	RCC->CR &= ~RCC_CR_PLLON;
+}
+
+// Everything that was set up for a fixed PCLK
+static void CLOCK_Reconfigure()
+{
+	SystemCoreClockUpdate();
+	TIMING_ClockChanged();
+	TIMERS_ClockChanged();
+	USART_ClockChanged();
+	I2C1_ClockChanged();
+	DHT22_ClockChanged();
+}
+
+/*
+ * The regulator is raised before the clock and lowered after it, range 1
+ * is needed above 16 MHz. Flash stays on one wait state, which is valid
+ * in every range. Interrupts are masked so no handler runs with a
+ * peripheral set up for the other clock.
+ */
+void CLOCK_SetMode(CLOCK_Mode mode)
+{
+	if (mode == clock_mode || !CLOCK_SCALING_ENABLE)
+	{
+		return;
+	}
+
+	__disable_irq();
+
+	if (mode == CLOCK_HIGH)
+	{
+		CLOCK_SetVoltageRange(PWR_CR_VOS_0);	// Range 1, 1.8 V
+		CLOCK_SwitchToPLL();
+	}
+
+	else
+	{
+		CLOCK_SwitchToMSI();
+		CLOCK_SetVoltageRange(PWR_CR_VOS_1);	// Range 2, 1.5 V
+	}
+
+	clock_mode = mode;
+	CLOCK_Reconfigure();
+
+	__enable_irq();
+}
+
+// Steps up for a burst. Fails, leaving the clock as it is, while a Modbus
+// frame is on the line or an I2C transfer is queued: the new I2C1 timing
+// needs a peripheral reset, so the burst runs on MSI instead of waiting.
+uint8_t CLOCK_Boost()
+{
+	if (clock_mode == CLOCK_HIGH)
+	{
+		return 1;
+	}
+
+	if (MODBUS_LineBusy() || !I2C1_Idle())
+	{
+		return 0;
+	}
+
+	CLOCK_SetMode(CLOCK_HIGH);
+	return 1;
+}
+
+// Drops to MSI once no burst is running and nothing is on the wires
+void CLOCK_ScaleDown()
+{
+	if (clock_mode == CLOCK_LOW)
+	{
+		return;
+	}
+
+	if (MODBUS_Busy() || !I2C1_Idle() || SAMPLER_MsUntilDue() < CLOCK_LOW_MIN_IDLE_MS)
+	{
+		return;
+	}
+
+	CLOCK_SetMode(CLOCK_LOW);
+}
+
+// After Stop mode the core runs on MSI in its configured range. The HSI,
+// needed by the ADC, and on the high clock the PLL are restarted. p.103
+void CLOCK_Resume()
+{
+	if (clock_mode == CLOCK_HIGH)
+	{
+		CLOCK_SwitchToPLL();
+		return;
+	}
+
+	RCC->CR |= RCC_CR_HSION;
+	while (!(RCC->CR & RCC_CR_HSIRDY)){}
+}
@@ -0,0 +1,45 @@
+/*
+ * clock.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef PERIPHERALS_CLOCK_H_
+#define PERIPHERALS_CLOCK_H_
+
+#include "stm32l1xx.h"
+
+/*
+ * Clock manager. The station idles on MSI at 4.194 MHz in voltage range 2
+ * and steps up to the 32 MHz PLL in range 1 for bursts: Modbus request
+ * handling and sampling (conversions, filters). On every transition the
+ * USART baud rates, I2C1 timing, timer prescalers and SysTick are
+ * recomputed for the new clock.
+ *
+ * Range 3 would allow the same MSI clock, but the HSI is not available in
+ * range 3 and the ADC scan runs on the HSI, so range 2 is the lowest that
+ * keeps the analog channels sampling.
+ *
+ * A transition is only made while no USART, I2C or timer activity is in
+ * flight, see CLOCK_Boost() and CLOCK_ScaleDown().
+ */
+#define CLOCK_SCALING_ENABLE 1
+#define CLOCK_LOW_MSI_RANGE RCC_ICSCR_MSIRANGE_6 // 4.194 MHz
+#define CLOCK_LOW_MIN_IDLE_MS 2 // Stay on the PLL when the next sample is this close
+
+typedef enum {
+	CLOCK_LOW = 0,
+	CLOCK_HIGH = 1
+} CLOCK_Mode;
+
+void CLOCK_init();
+CLOCK_Mode CLOCK_GetMode();
+void CLOCK_SetMode(CLOCK_Mode mode);
+uint8_t CLOCK_Boost();
+void CLOCK_ScaleDown();
+void CLOCK_Resume();
+uint32_t CLOCK_GetPclk1Hz();
+uint32_t CLOCK_GetPclk2Hz();
+
+#endif /* PERIPHERALS_CLOCK_H_ */
@@ -0,0 +1,93 @@
+/*
+ * eeprom.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "eeprom.h"
+#include "timing.h"
+
+// Word access to the data EEPROM, offsets are relative to FLASH_EEPROM_BASE
+// and must be word aligned. p.82
+
+static void EEPROM_Unlock()
+{
+	if (FLASH->PECR & FLASH_PECR_PELOCK)
+	{
+		FLASH->PEKEYR = EEPROM_PEKEY1;
+		FLASH->PEKEYR = EEPROM_PEKEY2;
+	}
+}
+
+static void EEPROM_Lock()
+{
+	FLASH->PECR |= FLASH_PECR_PELOCK;
+}
+
+static EEPROM_Status EEPROM_WaitReady()
+{
+	uint32_t deadline = TIMING_DeadlineUs(EEPROM_WORD_TIMEOUT_US);
+
+	while (FLASH->SR & FLASH_SR_BSY)
+	{
+		if (TIMING_Expired(deadline))
+		{
+			return EEPROM_TIMEOUT;
+		}
+	}
+
+	if (FLASH->SR & (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR))
+	{
+		FLASH->SR = FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_SIZERR; // Write 1 to clear
+		return EEPROM_ERROR;
+	}
+
+	return EEPROM_OK;
+}
+
+uint32_t EEPROM_ReadWord(uint32_t offset)
+{
+	return *(volatile uint32_t *)(FLASH_EEPROM_BASE + offset);
+}
+
+void EEPROM_Read(uint32_t offset, void *data, uint32_t length)
+{
+	uint32_t *words = data;
+
+	for (uint32_t i = 0; i < length / 4; ++i)
+	{
+		words[i] = EEPROM_ReadWord(offset + 4 * i);
+	}
+}
+
+// Words that already hold the wanted value are skipped, so rewriting an
+// unchanged record costs no erase/program cycles.
+EEPROM_Status EEPROM_Write(uint32_t offset, const void *data, uint32_t length)
+{
+	const uint32_t *words = data;
+	EEPROM_Status status = EEPROM_OK;
+
+	if ((offset & 3) || (length & 3) || offset + length > EEPROM_SIZE)
+	{
+		return EEPROM_OUT_OF_RANGE;
+	}
+
+	EEPROM_Unlock();
+	FLASH->PECR &= ~FLASH_PECR_FTDW; // Erase only when the word is not already erased
+
+	for (uint32_t i = 0; i < length / 4 && status == EEPROM_OK; ++i)
+	{
+		if (EEPROM_ReadWord(offset + 4 * i) == words[i])
+		{
+			continue;
+		}
+
+		*(volatile uint32_t *)(FLASH_EEPROM_BASE + offset + 4 * i) = words[i];
+		status = EEPROM_WaitReady();
+	}
+
+	EEPROM_Lock();
+
+	return status;
+}
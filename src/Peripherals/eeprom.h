@@ -0,0 +1,31 @@
+/*
+ * eeprom.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef PERIPHERALS_EEPROM_H_
+#define PERIPHERALS_EEPROM_H_
+
+#include "stm32l1xx.h"
+
+#define EEPROM_SIZE 0x4000 // 16 KB data EEPROM on the STM32L152RE
+
+#define EEPROM_PEKEY1 0x89ABCDEF
+#define EEPROM_PEKEY2 0x02030405
+
+typedef enum {
+	EEPROM_OK = 0,
+	EEPROM_ERROR = 1,
+	EEPROM_OUT_OF_RANGE = 2,
+	EEPROM_TIMEOUT = 3
+} EEPROM_Status;
+
+#define EEPROM_WORD_TIMEOUT_US 10000 // Erase + program of one word is ~3.3 ms
+
+uint32_t EEPROM_ReadWord(uint32_t offset);
+void EEPROM_Read(uint32_t offset, void *data, uint32_t length);
+EEPROM_Status EEPROM_Write(uint32_t offset, const void *data, uint32_t length);
+
+#endif /* PERIPHERALS_EEPROM_H_ */
@@ -7,15 +7,53 @@
 
 #include "exti_handlers.h"
 
-void EXTI9_5_IRQHandler(void)
+void TIM11_IRQHandler(void)
 {
-	if (EXTI->PR & EXTI_PR_PR7)
-	{
-        DHT22_IRQHandler();
-	}
+	DHT22_IRQHandler();
 }
 
 void USART1_IRQHandler(void)
 {
 	MODBUS_IRQHandler();
 }
+
+void TIM3_IRQHandler(void)
+{
+	MODBUS_TimerIRQHandler();
+}
+
+void SysTick_Handler(void)
+{
+	TIMING_SysTickHandler();
+	SGP30_IAQ_TickHandler();
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+	ADC_DMAHandler();
+}
+
+void I2C1_EV_IRQHandler(void)
+{
+	I2C1_EventIRQHandler();
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+	I2C1_ErrorIRQHandler();
+}
+
+void DMA1_Channel7_IRQHandler(void)
+{
+	I2C1_RxDMAHandler();
+}
+
+void RTC_WKUP_IRQHandler(void)
+{
+	RTC_WakeupIRQHandler();
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+	POWER_RxWakeIRQHandler();
+}
@@ -10,5 +10,12 @@
 
 #include "dht22.h"
 #include "usart.h"
+#include "timers.h"
+#include "adc.h"
+#include "i2c.h"
+#include "timing.h"
+#include "rtc.h"
+#include "power.h"
+#include "sgp30_iaq.h"
 
 #endif /* PERIPHERALS_EXTI_HANDLERS_H_ */
@@ -6,11 +6,68 @@
  */
 
 #include "i2c.h"
+#include "timing.h"
+#include "events.h"
+#include "clock.h"
+#include <stddef.h>
+
+static I2C1_Transfer *i2c1_queue[I2C1_QUEUE_SIZE];
+static volatile uint8_t i2c1_head = 0;
+static volatile uint8_t i2c1_count = 0;
+static volatile I2C1_State i2c1_state = I2C1_IDLE;
+
+static volatile I2C1_Speed i2c1_speed = I2C1_DEFAULT_SPEED;
+static volatile uint8_t i2c1_error_count = 0; // Consecutive bus errors and timeouts
+static volatile uint8_t i2c1_recover = 0; // Set in interrupt context, handled by I2C1_Process()
+
+static void I2C1_StartNext(void);
+
+static void I2C1_Configure(void)
+{
+	uint32_t pclk1 = CLOCK_GetPclk1Hz();
+	uint32_t pclk1_mhz = pclk1 / 1000000;
+	uint32_t ccr;
+
+	I2C1->CR1 = 0x8000;				//software reset I2C1 SWRST p.682
+	I2C1->CR1 &= ~0x8000;			//stop reset
+	I2C1->CR2 = pclk1_mhz & I2C_CR2_FREQ;	//peripheral clock in MHz, 2...32 p.684
+
+	if (i2c1_speed == I2C1_FAST_MODE)
+	{
+		/*Fast mode with DUTY=0: tlow = 2 * thigh, so one bus period is
+		3 * CCR * TPCLK1. Rounded up so the bus never runs above 400 kHz,
+		at 32 MHz CCR=27 gives 395 kHz. p. 692*/
+		ccr = (pclk1 + 3 * I2C1_FAST_HZ - 1) / (3 * I2C1_FAST_HZ);
+		I2C1->CCR = I2C_CCR_FS | ((ccr < 1) ? 1 : ccr);
+
+		//maximum rise time in fm mode = 300ns
+		I2C1->TRISE = pclk1_mhz * 300 / 1000 + 1;	//at 32 MHz 300ns/31,25ns=9+1=10, p.693
+	}
+
+	else
+	{
+		/*how to calculate CCR
+		TPCLK1=1/32MHz=31,25ns
+		tI2C_bus=1/100kHz=10us=10000ns
+		tI2C_bus_div2=10000ns/2=5000ns
+		CCR value=tI2C_bus_div2/TPCLK1=5000ns/31,25ns=160
+		p. 692*/
+		ccr = pclk1 / (2 * I2C1_STANDARD_HZ);
+		I2C1->CCR = (ccr < 4) ? 4 : ccr;	//minimum 4 in sm mode
+
+		//maximum rise time in sm mode = 1000ns. Equation 1000 ns/TPCK1
+		I2C1->TRISE = pclk1_mhz + 1;	//1000ns/31,25ns=32+1=33, p.693
+	}
+
+	I2C1->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;	//event and error interrupts p.685
+	I2C1->CR1 |= 0x0001;			//peripheral enable (I2C1)
+}
 
 void I2C1_Init(void)
 {
 	RCC->AHBENR |= 2;			//Enable GPIOB clock PB8(D15)=SCL,PB9(D14)=SDA.
 	RCC->APB1ENR |= (1<<21);	//Enable I2C1_EN clock
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 
 	//configures PB8,PB9 to I2C1_EN
 	GPIOB->AFR[1] &= ~0x000000FF;	//PB8,PB9 I2C1 SCL, SDA. AFRH8 and AFRH9. clear
@@ -20,104 +77,375 @@ void I2C1_Init(void)
 	GPIOB->OTYPER |= 0x00000300;	//output open-drain. p.184
 	GPIOB->PUPDR &= ~0x000F0000;	//no pull-up resistors for PB8 and PB9 p.185
 
-	I2C1->CR1 = 0x8000;				//software reset I2C1 SWRST p.682
-	I2C1->CR1 &= ~0x8000;			//stop reset
-	I2C1->CR2 = 0x0020;				//peripheral clock 32 MHz
-
-	/*how to calculate CCR
-	TPCLK1=1/32MHz=31,25ns
-	tI2C_bus=1/100kHz=10us=10000ns
-	tI2C_bus_div2=10000ns/2=5000ns
-	CCR value=tI2C_bus_div2/TPCLK1=5000ns/31,25ns=160
-	p. 692*/
-	I2C1->CCR = 160;
-
-	//maximum rise time in sm mode = 1000ns. Equation 1000 ns/TPCK1
-	I2C1->TRISE = 33;				//1000ns/31,25ns=32+1=33, p.693
-	I2C1->CR1 |= 0x0001;			//peripheral enable (I2C1)
+	// DMA1 channel 6 = I2C1_TX, channel 7 = I2C1_RX, 8-bit, memory increment p.251
+	DMA1_Channel6->CCR = 0;
+	DMA1_Channel6->CPAR = (uint32_t)&I2C1->DR;
+	DMA1_Channel7->CCR = 0;
+	DMA1_Channel7->CPAR = (uint32_t)&I2C1->DR;
+
+	// A slave reset halfway through a read can still hold SDA low
+	if (!(GPIOB->IDR & (1<<9)))
+	{
+		I2C1_RecoverBus();
+	}
+
+	else
+	{
+		I2C1_Configure();
+	}
+
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+	NVIC_EnableIRQ(DMA1_Channel7_IRQn);
 }
 
-void I2C1_Write(uint8_t address, int n, uint8_t* data)
+// Ends the active transfer, hands it to its callback and starts the next one
+static void I2C1_Complete(I2C1_Status status)
 {
-	volatile int tmp;
-	int i;
+	I2C1_Transfer *transfer = i2c1_queue[i2c1_head];
+
+	DMA1_Channel6->CCR &= ~DMA_CCR_EN;
+	DMA1_Channel7->CCR &= ~DMA_CCR_EN;
+	I2C1->CR2 &= ~(I2C_CR2_DMAEN | I2C_CR2_LAST | I2C_CR2_ITBUFEN);
+
+	i2c1_head = (i2c1_head + 1) % I2C1_QUEUE_SIZE;
+	i2c1_count--;
+	i2c1_state = I2C1_IDLE;
+
+	if (status == I2C1_BUS_ERROR || status == I2C1_TIMEOUT)
+	{
+		// Fast mode is the first suspect on a long or noisy bus
+		if (++i2c1_error_count >= I2C1_FALLBACK_ERRORS && i2c1_speed == I2C1_FAST_MODE)
+		{
+			i2c1_speed = I2C1_STANDARD_MODE;
+			i2c1_error_count = 0;
+		}
+
+		i2c1_recover = 1;
+	}
 
-	while(I2C1->SR2 & 2){}			//wait until bus not busy
+	else if (status == I2C1_OK)
+	{
+		i2c1_error_count = 0;
+	}
+
+	transfer->status = status;
+	EVENT_Post(EVENT_I2C_DONE);
+	if (transfer->callback != NULL)
+	{
+		transfer->callback(transfer);
+	}
+
+	I2C1_StartNext();
+}
+
+static void I2C1_StartNext(void)
+{
+	// Waits for I2C1_Process() to recover the bus first
+	if (i2c1_state != I2C1_IDLE || i2c1_count == 0 || i2c1_recover)
+	{
+		return;
+	}
+
+	I2C1_Transfer *transfer = i2c1_queue[i2c1_head];
+
+	transfer->start_ms = TIMING_GetTick();
+	i2c1_state = I2C1_START;
 
 	I2C1->CR1 &= ~0x800;			//disable POS p.682
-	I2C1->CR1 |= 0x100;				//generate start p.694
-	while(!(I2C1->SR1&1)){}			//wait until start condition generated
+	I2C1->CR1 |= 0x100;				//generate start p.694, SB raises the event interrupt
+}
 
-	I2C1->DR=address << 1;			//transmit slave address
-	while(!(I2C1->SR1 & 2)){}		//wait until end of address transmission p.690
+// Queues a transfer, it starts right away if the bus is free
+I2C1_Status I2C1_Submit(I2C1_Transfer *transfer)
+{
+	I2C1_Status status = I2C1_PENDING;
+
+	transfer->status = I2C1_PENDING;
 
-	tmp=I2C1->SR2;					//Reading I2C_SR2 after reading I2C_SR1 clears the ADDR flag p691
-	while(!(I2C1->SR1 & 0x80)){}	//wait until data register empty p.689
+	NVIC_DisableIRQ(I2C1_EV_IRQn);
+	NVIC_DisableIRQ(I2C1_ER_IRQn);
+
+	if (i2c1_count == I2C1_QUEUE_SIZE)
+	{
+		transfer->status = I2C1_QUEUE_FULL;
+		status = I2C1_QUEUE_FULL;
+	}
 
-	//write data
-	for(i=0;i<n;i++)
+	else
 	{
-		while(!(I2C1->SR1 & 0x80)){}	//wait until data register empty p.689
-		I2C1->DR=*data++;				//send command
+		i2c1_queue[(i2c1_head + i2c1_count) % I2C1_QUEUE_SIZE] = transfer;
+		i2c1_count++;
+		I2C1_StartNext();
 	}
 
-	while(!(I2C1->SR1 & 4)){}		//wait until byte transfer finished p.690
-	I2C1->CR1 |= (1<<9);			//generate stop
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+
+	return status;
 }
 
-void I2C1_ByteWrite(uint8_t address, uint8_t command)
+// Aborts the active transfer once its timeout has passed and recovers the
+// bus after an error, a hung transfer leaves the bus in an unknown state.
+// The recovery blocks for about 0.1 ms, so it runs here and not in the
+// error interrupt.
+void I2C1_Process(void)
 {
-	volatile int tmp;
+	if (i2c1_state != I2C1_IDLE)
+	{
+		I2C1_Transfer *transfer = i2c1_queue[i2c1_head];
+		uint16_t timeout = (transfer->timeout_ms != 0) ? transfer->timeout_ms : I2C1_TIMEOUT_MS;
+
+		if (TIMING_GetTick() - transfer->start_ms <= timeout)
+		{
+			return;
+		}
+
+		NVIC_DisableIRQ(I2C1_EV_IRQn);
+		NVIC_DisableIRQ(I2C1_ER_IRQn);
+
+		if (i2c1_state != I2C1_IDLE && i2c1_queue[i2c1_head] == transfer)
+		{
+			I2C1->CR1 |= (1<<9);	//generate stop
+			I2C1_Complete(I2C1_TIMEOUT);
+		}
+
+		NVIC_EnableIRQ(I2C1_EV_IRQn);
+		NVIC_EnableIRQ(I2C1_ER_IRQn);
+	}
 
-	while(I2C1->SR2 & 2){}			//wait until bus not busy
+	if (!i2c1_recover)
+	{
+		return;
+	}
 
-	I2C1->CR1 &= ~0x800;			//Acknowledge clear p.682
-	I2C1->CR1 |= 0x100;				//generate start p.694
-	while(!(I2C1->SR1&1)){}			//wait until start condition generated
+	NVIC_DisableIRQ(I2C1_EV_IRQn);
+	NVIC_DisableIRQ(I2C1_ER_IRQn);
 
-	I2C1->DR=address << 1;			//transmit slave address
-	while(!(I2C1->SR1 & 2)){}		//wait until end of address transmission p.690
+	I2C1_RecoverBus();
+	I2C1_StartNext();
 
-	tmp=I2C1->SR2;					//Reading I2C_SR2 after reading I2C_SR1 clears the ADDR flag p691
-	while(!(I2C1->SR1 & 0x80)){}	//wait until data register empty p.689
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+}
 
-	I2C1->DR = command;				//send command
+// No transfer queued and no bus recovery outstanding
+uint8_t I2C1_Idle(void)
+{
+	return i2c1_count == 0 && !i2c1_recover;
+}
 
-	while(!(I2C1->SR1 & 4)){}		//wait until byte transfer finished p.690
-	I2C1->CR1 |= (1<<9);			//generate stop
+// New CCR/TRISE for the new PCLK1, only while I2C1_Idle()
+void I2C1_ClockChanged(void)
+{
+	I2C1_Configure();
 }
 
-void I2C1_Read(uint8_t address, int n, uint8_t* data)
+// Takes effect once the bus is idle, a failed fast-mode bus can be retried this way
+void I2C1_SetSpeed(I2C1_Speed speed)
 {
-	volatile int tmp;
+	i2c1_speed = speed;
+	i2c1_error_count = 0;
+	i2c1_recover = 1;
+}
+
+I2C1_Speed I2C1_GetSpeed(void)
+{
+	return i2c1_speed;
+}
+
+/*
+ * Bus clear, UM10204 3.1.16. PB8 (SCL) and PB9 (SDA) are switched to
+ * open-drain GPIO outputs and SCL is pulsed until the slave releases SDA,
+ * then a STOP condition ends whatever transfer the slave thinks is running.
+ * Must not be called while a transfer is active.
+ */
+void I2C1_RecoverBus(void)
+{
+	I2C1->CR1 &= ~0x0001;			//peripheral disable
+
+	GPIOB->BSRR = (1<<8) | (1<<9);	//release both lines
+	GPIOB->MODER &= ~0x000F0000;
+	GPIOB->MODER |= 0x00050000;		//General purpose output mode PB8,PB9 p.184
+
+	for (int i = 0; i < I2C1_RECOVERY_CLOCKS && !(GPIOB->IDR & (1<<9)); ++i)
+	{
+		GPIOB->BSRR = (1<<(8+16));	//SCL low
+		delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+		GPIOB->BSRR = (1<<8);		//SCL high
+		delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+	}
+
+	// STOP: SDA rises while SCL is high
+	GPIOB->BSRR = (1<<(8+16));
+	delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+	GPIOB->BSRR = (1<<(9+16));
+	delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+	GPIOB->BSRR = (1<<8);
+	delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+	GPIOB->BSRR = (1<<9);
+	delay_us(I2C1_RECOVERY_HALF_PERIOD_US);
+
+	GPIOB->MODER &= ~0x000F0000;
+	GPIOB->MODER |= 0x000A0000;		//Alternate function mode PB8,PB9
+
+	i2c1_recover = 0;
+	I2C1_Configure();
+}
+
+static I2C1_Status I2C1_Transfer_Blocking(uint8_t address, uint8_t read, int n, uint8_t* data)
+{
+	I2C1_Transfer transfer = {
+		.address = address,
+		.read = read,
+		.data = data,
+		.length = n,
+	};
+
+	if (I2C1_Submit(&transfer) != I2C1_PENDING)
+	{
+		return transfer.status;
+	}
+
+	while (transfer.status == I2C1_PENDING)
+	{
+		I2C1_Process();
+	}
+
+	return transfer.status;
+}
+
+// Blocking helpers for callers that need the result inline, bounded by the timeout
+I2C1_Status I2C1_Write(uint8_t address, int n, uint8_t* data)
+{
+	return I2C1_Transfer_Blocking(address, 0, n, data);
+}
 
-	while(I2C1->SR2 & 2){}			//wait until bus not busy
-	I2C1->CR1 &= ~0x800;			//Acknowledge clear p.682
+I2C1_Status I2C1_Read(uint8_t address, int n, uint8_t* data)
+{
+	return I2C1_Transfer_Blocking(address, 1, n, data);
+}
 
-	I2C1->CR1 |= 0x100;				//generate start p.694
-	while(!(I2C1->SR1&1)){}			//wait until start condition generated
+// Called on ADDR, sets up the data phase. RM0038 p.669-672
+static void I2C1_AddressSent(I2C1_Transfer *transfer)
+{
+	volatile int tmp;
 
-	I2C1->DR=address << 1;			//transmit slave address
-	while(!(I2C1->SR1 & 2)){}		//wait until end of address transmission p.690
+	if (!transfer->read)
+	{
+		DMA1_Channel6->CMAR = (uint32_t)transfer->data;
+		DMA1_Channel6->CNDTR = transfer->length;
+		DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+		I2C1->CR2 |= I2C_CR2_DMAEN;
+		i2c1_state = I2C1_WRITE;
 
-	tmp=I2C1->SR2;					//Reading I2C_SR2 after reading I2C_SR1 clears the ADDR flag p691
-	while(!(I2C1->SR1 & 0x80)){}	//wait until data register empty p.689
+		tmp = I2C1->SR2;			//Reading I2C_SR2 after reading I2C_SR1 clears the ADDR flag p691
+		return;
+	}
 
-	I2C1->CR1 |= 0x100;				//generate repeated start p.694
-	while(!(I2C1->SR1&1)){}			//wait until start condition generated
+	i2c1_state = I2C1_READ;
 
-	I2C1->DR=address << 1|1;		//transmit slave address
-	while(!(I2C1->SR1 & 2)){}		//wait until end of address transmission p.690
+	if (transfer->length == 1)
+	{
+		I2C1->CR1 &= ~(1<<10);		//NACK the only byte p.673
+		tmp = I2C1->SR2;
+		I2C1->CR1 |= (1<<9);		//generate stop
+		I2C1->CR2 |= I2C_CR2_ITBUFEN;	//RXNE interrupt
+		return;
+	}
 
-	tmp=I2C1->SR2;					//Reading I2C_SR2 after reading I2C_SR1 clears the ADDR flag p691
+	// DMA with LAST NACKs the final byte by itself, the DMA TC interrupt stops
+	DMA1_Channel7->CMAR = (uint32_t)transfer->data;
+	DMA1_Channel7->CNDTR = transfer->length;
+	DMA1_Channel7->CCR = DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_EN;
+	I2C1->CR2 |= I2C_CR2_DMAEN | I2C_CR2_LAST;
 	I2C1->CR1 |= (1<<10);			//Enable acknowledge p.683
 
-	while(n > 0)					//read data from chip
+	tmp = I2C1->SR2;
+	(void)tmp;
+}
+
+void I2C1_EventIRQHandler(void)
+{
+	uint16_t sr1 = I2C1->SR1;
+	I2C1_Transfer *transfer = i2c1_queue[i2c1_head];
+
+	if (i2c1_state == I2C1_IDLE)
+	{
+		return;
+	}
+
+	if (sr1 & I2C_SR1_SB)
+	{
+		I2C1->DR = (transfer->address << 1) | transfer->read;	//transmit slave address, clears SB
+		i2c1_state = I2C1_ADDRESS;
+	}
+
+	else if (sr1 & I2C_SR1_ADDR)
+	{
+		if (transfer->length == 0)
+		{
+			volatile int tmp = I2C1->SR2;
+			(void)tmp;
+			I2C1->CR1 |= (1<<9);	//generate stop
+			I2C1_Complete(I2C1_OK);
+			return;
+		}
+
+		I2C1_AddressSent(transfer);
+	}
+
+	// Last byte of a write has left the shift register
+	else if ((sr1 & I2C_SR1_BTF) && i2c1_state == I2C1_WRITE && DMA1_Channel6->CNDTR == 0)
+	{
+		I2C1->CR1 |= (1<<9);		//generate stop
+		I2C1_Complete(I2C1_OK);
+	}
+
+	else if ((sr1 & I2C_SR1_RXNE) && i2c1_state == I2C1_READ && transfer->length == 1)
+	{
+		transfer->data[0] = I2C1->DR;
+		I2C1_Complete(I2C1_OK);
+	}
+}
+
+void I2C1_ErrorIRQHandler(void)
+{
+	uint16_t sr1 = I2C1->SR1;
+
+	I2C1->SR1 = ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR | I2C_SR1_TIMEOUT);	//flags are cleared by writing 0 p.688
+
+	if (i2c1_state == I2C1_IDLE)
+	{
+		return;
+	}
+
+	if (sr1 & I2C_SR1_AF)
 	{
-		while(!(I2C1->SR1 & 0x40)){}	//wait until RXNE flag is set
-		(*data++) = I2C1->DR;			//read data from DR
-		n--;
+		I2C1->CR1 |= (1<<9);		//generate stop
+		I2C1_Complete(I2C1_NACK);
+	}
+
+	// Bus error or arbitration lost, I2C1_Process() recovers the bus
+	else
+	{
+		I2C1->CR1 &= ~0x0001;		//peripheral disable
+		I2C1_Complete(I2C1_BUS_ERROR);
+	}
+}
+
+// Last byte of a DMA read has arrived
+void I2C1_RxDMAHandler(void)
+{
+	if (DMA1->ISR & DMA_ISR_TCIF7)
+	{
+		DMA1->IFCR = DMA_IFCR_CTCIF7;
+
+		if (i2c1_state == I2C1_READ)
+		{
+			I2C1->CR1 |= (1<<9);	//generate stop
+			I2C1->CR1 &= ~(1<<10);	//disable acknowledge p.682
+			I2C1_Complete(I2C1_OK);
+		}
 	}
-	I2C1->CR1 |= (1<<9);			//generate stop p.682
-	I2C1->CR1 &= ~(1<<10);			//disable acknowledge p.682
 }
@@ -10,9 +10,79 @@
 
 #include "stm32l1xx.h"
 
+/*
+ * Asynchronous I2C1 master. Transfers are queued with I2C1_Submit() and run
+ * from the event/error interrupts, data goes through DMA1 channel 6 (TX) and
+ * channel 7 (RX). The callback runs in interrupt context when the transfer
+ * ends. I2C1_Process() from the main loop aborts transfers that overrun
+ * their timeout.
+ */
+#define I2C1_QUEUE_SIZE 4
+#define I2C1_TIMEOUT_MS 5 // Default per transfer, 6 bytes take ~0.6 ms at 100 kHz
+
+/*
+ * Bus timing is computed from the PCLK1 frequency on every (re)configure.
+ * Fast mode drops back to standard mode after I2C1_FALLBACK_ERRORS bus
+ * errors or timeouts in a row. After such an error I2C1_Process() runs the
+ * bus recovery: SCL is clocked by hand until a slave holding SDA low lets
+ * go, then a STOP is generated and the peripheral is reset.
+ */
+#define I2C1_STANDARD_HZ 100000
+#define I2C1_FAST_HZ 400000
+#define I2C1_DEFAULT_SPEED I2C1_FAST_MODE // SGP30 supports 400 kHz
+#define I2C1_FALLBACK_ERRORS 3
+#define I2C1_RECOVERY_CLOCKS 9 // A slave can hold SDA for at most 8 data bits + ACK
+#define I2C1_RECOVERY_HALF_PERIOD_US 5 // 100 kHz
+
+typedef enum {
+	I2C1_OK = 0,
+	I2C1_PENDING = 1,
+	I2C1_NACK = 2,
+	I2C1_BUS_ERROR = 3, // Bus error or arbitration lost
+	I2C1_TIMEOUT = 4,
+	I2C1_QUEUE_FULL = 5
+} I2C1_Status;
+
+typedef enum {
+	I2C1_IDLE = 0,
+	I2C1_START = 1,
+	I2C1_ADDRESS = 2,
+	I2C1_WRITE = 3,
+	I2C1_READ = 4
+} I2C1_State;
+
+typedef enum {
+	I2C1_STANDARD_MODE = 0,
+	I2C1_FAST_MODE = 1
+} I2C1_Speed;
+
+struct I2C1_Transfer;
+typedef void (*I2C1_Callback)(struct I2C1_Transfer *transfer);
+
+typedef struct I2C1_Transfer {
+	uint8_t address; // 7-bit
+	uint8_t read;
+	uint8_t *data;
+	uint16_t length;
+	uint16_t timeout_ms; // 0 = I2C1_TIMEOUT_MS
+	I2C1_Callback callback; // May be NULL
+	volatile I2C1_Status status;
+	uint32_t start_ms;
+} I2C1_Transfer;
+
 void I2C1_Init(void);
-void I2C1_Write(uint8_t address, int n, uint8_t* data);
-void I2C1_ByteWrite(uint8_t address, uint8_t command);
-void I2C1_Read(uint8_t address, int n, uint8_t* data);
+I2C1_Status I2C1_Submit(I2C1_Transfer *transfer);
+void I2C1_Process(void);
+uint8_t I2C1_Idle(void);
+void I2C1_ClockChanged(void);
+void I2C1_SetSpeed(I2C1_Speed speed);
+I2C1_Speed I2C1_GetSpeed(void);
+void I2C1_RecoverBus(void);
+I2C1_Status I2C1_Write(uint8_t address, int n, uint8_t* data);
+I2C1_Status I2C1_Read(uint8_t address, int n, uint8_t* data);
+
+void I2C1_EventIRQHandler(void);
+void I2C1_ErrorIRQHandler(void);
+void I2C1_RxDMAHandler(void);
 
 #endif /* PERIPHERALS_I2C_H_ */
@@ -12,17 +12,32 @@
 #include "sgp30.h"
 #include "usart.h"
 #include "gpio.h"
+#include "sampler.h"
+#include "modbus_map.h"
+#include "config.h"
+#include "timers.h"
+#include "events.h"
 
 #define DEBUG 0
 
-volatile uint8_t frame_ready = 0;
-
 // Ring buffer
 volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
 volatile uint8_t buffer_OVF = 0;
 volatile uint16_t rx_head = 0, rx_tail = 0;
 
-uint8_t MODBUS_Slaves[SLAVE_COUNT] = {LMT84LP_MODBUS_ADDRESS, NSL19M51_MODBUS_ADDRESS, SGP30_MODBUS_ADDRESS, DHT22_MODBUS_ADDRESS};
+// Frame currently being received and the queue of completed frames
+volatile uint16_t rx_frame_start = 0;
+volatile uint16_t rx_frame_length = 0;
+volatile uint8_t rx_frame_flags = 0;
+volatile uint8_t rx_t15_expired = 0;
+
+volatile MODBUS_FrameSlice frame_queue[MODBUS_FRAME_QUEUE_SIZE];
+volatile uint8_t frame_queue_head = 0, frame_queue_tail = 0;
+static uint16_t rx_release = 0;
+
+// Response being sent by DMA, RE/DE is released from the TC interrupt
+static uint8_t tx_buffer[MODBUS_MAX_FRAME_SIZE];
+static volatile uint8_t tx_busy = 0;
 
 //parameter wLenght = how my bytes in your frame?
 //*nData = your first element in frame array
@@ -76,14 +91,14 @@ uint16_t CRC16(uint8_t *nData, uint16_t wLength)
 	return wCRCWord;
 }
 
-MODBUS_Status MODBUS_VerifyCRC(uint8_t *MODBUS_Frame)
+MODBUS_Status MODBUS_VerifyCRC(uint8_t *MODBUS_Frame, uint16_t length)
 {
 	uint16_t MODBUS_FrameCRC = 0;
 
-	MODBUS_FrameCRC = CRC16(MODBUS_Frame, MODBUS_FRAME_SIZE - 2); // Exclude the CRC itself
+	MODBUS_FrameCRC = CRC16(MODBUS_Frame, length - 2); // Exclude the CRC itself
 
-	uint8_t CRC_lsb = (MODBUS_FrameCRC >> 8) == MODBUS_Frame[MODBUS_FRAME_SIZE - 2];
-	uint8_t CRC_msb = (MODBUS_FrameCRC & 0x00FF) == MODBUS_Frame[MODBUS_FRAME_SIZE - 1];
+	uint8_t CRC_lsb = (MODBUS_FrameCRC >> 8) == MODBUS_Frame[length - 2];
+	uint8_t CRC_msb = (MODBUS_FrameCRC & 0x00FF) == MODBUS_Frame[length - 1];
 	if (CRC_lsb && CRC_msb)
 	{
 		return MODBUS_CRC_VALID;
@@ -92,87 +107,142 @@ MODBUS_Status MODBUS_VerifyCRC(uint8_t *MODBUS_Frame)
 	return MODBUS_CRC_INVALID;
 }
 
+// Slave addresses come from the station config and can change at runtime
 MODBUS_Status MODBUS_CheckAddress(uint8_t address)
 {
-    for (int i = 0; i < SLAVE_COUNT; ++i)
-    {
-        if (MODBUS_Slaves[i] == address)
-        {
-            return MODBUS_ADDR_VALID;
-        }
+	if (address == MODBUS_CLEAR_BUFFER_REG)
+	{
+		return MODBUS_RINGBUFFER_CLEAR;
+	}
 
-        else if (address == MODBUS_CLEAR_BUFFER_REG)
-        {
-        	return MODBUS_RINGBUFFER_CLEAR;
-        }
-    }
+	if (address == CONFIG_Get()->station_address || CONFIG_SensorFromAddress(address) != CONFIG_SENSOR_NONE)
+	{
+		return MODBUS_ADDR_VALID;
+	}
 
 	return MODBUS_ADDR_INVALID;
 }
 
-MODBUS_Status MODBUS_ReadFrame(uint8_t *MODBUS_Frame)
+void MODBUS_init()
 {
-	static uint8_t frame_index = 0;
-	uint8_t data;
+	/*
+	 * A byte is only seen once its stop bit is in, one character after its
+	 * start bit. The t1.5 check therefore runs one character late, so a byte
+	 * that started inside t1.5 has already landed when it is made.
+	 */
+#if MODBUS_RX_DMA
+	// IDLE already accounts for one character of silence
+	TIM3_InitOneShot(MODBUS_T15_US, MODBUS_T35_US - MODBUS_T10_US);
+	USART1_EnableRxDMA(rx_buffer, RX_BUFFER_SIZE);
+#else
+	TIM3_InitOneShot(MODBUS_T15_US + MODBUS_T10_US, MODBUS_T35_US);
+#endif
+}
 
-    while (MODBUS_RingBufferRead(&data) == MODBUS_RINGBUFFER_NOT_EMPTY)
-    {
+// Takes the oldest frame closed by the t3.5 timer out of the ring buffer.
+// Frames broken by a t1.5 gap or an overflow are dropped as a whole, so a
+// corrupted byte never shifts the following frames. A frame that does not
+// wrap around the end of rx_buffer is handed out in place, without copying.
+// The bytes stay reserved until MODBUS_ReleaseFrame() is called.
+MODBUS_Status MODBUS_ReadFrame(uint8_t **MODBUS_Frame, uint16_t *length)
+{
+	static uint8_t MODBUS_FrameScratch[MODBUS_MAX_FRAME_SIZE];
+
+	if (frame_queue_tail == frame_queue_head)
+	{
+		return MODBUS_FRAME_NOT_READY;
+	}
+
+	MODBUS_FrameSlice slice = frame_queue[frame_queue_tail];
+	frame_queue_tail = (frame_queue_tail + 1) % MODBUS_FRAME_QUEUE_SIZE;
+
+	rx_tail = slice.start;
+	rx_release = (slice.start + slice.length) % RX_BUFFER_SIZE;
+
+	if ((slice.flags & MODBUS_SLICE_BROKEN) || slice.length < MODBUS_MIN_FRAME_SIZE || slice.length > MODBUS_MAX_FRAME_SIZE)
+	{
+#if DEBUG > 0
+		USART2_write_buffer("Broken frame, discarding");
+#endif
+		return MODBUS_FRAME_ERR;
+	}
+
+	if (slice.start + slice.length <= RX_BUFFER_SIZE)
+	{
+		*MODBUS_Frame = (uint8_t *)&rx_buffer[slice.start];
+	}
+
+	else
+	{
+		for (uint16_t i = 0; i < slice.length; ++i)
+		{
+			MODBUS_FrameScratch[i] = rx_buffer[(slice.start + i) % RX_BUFFER_SIZE];
+		}
+		*MODBUS_Frame = MODBUS_FrameScratch;
+	}
 
 #if DEBUG == 1
-    	uint8_t buffer[100];
-        snprintf(buffer, sizeof(buffer), "%.2x ", data);
-        USART2_write_buffer(buffer);
+	for (uint16_t i = 0; i < slice.length; ++i)
+	{
+		uint8_t buffer[100];
+		snprintf(buffer, sizeof(buffer), "%.2x ", (*MODBUS_Frame)[i]);
+		USART2_write_buffer(buffer);
+	}
 #endif
 
-		if (frame_index == 0)
-        {
-			MODBUS_Status status = MODBUS_CheckAddress(data);
-            if (status == MODBUS_RINGBUFFER_CLEAR)
-            {
-        		return MODBUS_RINGBUFFER_CLEAR;
-            }
-
-            else if (status == MODBUS_ADDR_INVALID)
-            {
+	*length = slice.length;
+
+	MODBUS_Status status = MODBUS_CheckAddress((*MODBUS_Frame)[0]);
+	if (status == MODBUS_ADDR_INVALID)
+	{
 #if DEBUG > 0
-                USART2_write_buffer("Invalid start byte, skipping\n");
+		USART2_write_buffer("Frame not addressed to us, skipping");
 #endif
-                continue;
-            }
-        }
+	}
 
-    	MODBUS_Frame[frame_index++] = data;
+	return status;
+}
 
-    	if (frame_index == MODBUS_FRAME_SIZE)
-    	{
-    		frame_ready = 1;
-    		frame_index = 0;
-    		return MODBUS_ADDR_VALID;
-		}
-    }
+void MODBUS_ReleaseFrame()
+{
+	rx_tail = rx_release;
 
-    return MODBUS_FRAME_NOT_READY;
+	// One frame per pass, come back for the rest
+	if (frame_queue_tail != frame_queue_head)
+	{
+		EVENT_Post(EVENT_MODBUS_FRAME);
+	}
 }
 
 MODBUS_Status MODBUS_ReadSensor(uint8_t *MODBUS_Frame, uint8_t *MODBUS_ResponseFrame)
 {
 	MODBUS_Reading reading;
+	uint16_t age_ms;
+	uint8_t sensor = CONFIG_SensorFromAddress(MODBUS_Frame[0]);
+
+	// Replies are served from the sampler's cache, no conversion happens here
+	if (SAMPLER_GetReading(sensor, &reading, &age_ms) != SAMPLER_OK)
+	{
+		return MODBUS_SENSOR_READ_ERR;
+	}
 
-	switch (MODBUS_Frame[0])
+	if (MODBUS_Frame[3] == MODBUS_REG_SAMPLE_AGE)
 	{
-		case LMT84LP_MODBUS_ADDRESS:
-			LMT84LP_ModbusHander(&reading);
+		MODBUS_Build_ResponseFrameReading(MODBUS_ResponseFrame, MODBUS_Frame[0], age_ms);
+		return MODBUS_SENSOR_READ_OK;
+	}
+
+	switch (sensor)
+	{
+		case CONFIG_SENSOR_LMT84LP:
 			MODBUS_Build_ResponseFrameReading(MODBUS_ResponseFrame, MODBUS_Frame[0], reading.raw_reading[0]);
 			break;
 
-		case NSL19M51_MODBUS_ADDRESS:
-			NSL19M51_ModbusHandler(&reading);
+		case CONFIG_SENSOR_NSL19M51:
 			MODBUS_Build_ResponseFrameReading(MODBUS_ResponseFrame, MODBUS_Frame[0], reading.raw_reading[0]);
 			break;
 
-		case SGP30_MODBUS_ADDRESS:
-			sgp30_modbus_read(&reading);
-
+		case CONFIG_SENSOR_SGP30:
 			if (MODBUS_Frame[3] == 0x01)
 			{
 				MODBUS_Build_ResponseFrameReading(MODBUS_ResponseFrame, MODBUS_Frame[0], reading.co2_eq_ppm);
@@ -185,9 +255,7 @@ MODBUS_Status MODBUS_ReadSensor(uint8_t *MODBUS_Frame, uint8_t *MODBUS_ResponseF
 
 			break;
 
-		case DHT22_MODBUS_ADDRESS:
-			DHT22_ModbusHandler(&reading);
-
+		case CONFIG_SENSOR_DHT22:
 			if (MODBUS_Frame[3] == 0x01)
 			{
 				MODBUS_Build_ResponseFrameRaw(MODBUS_ResponseFrame, MODBUS_Frame[0], reading.raw_reading[0], reading.raw_reading[1]);
@@ -201,7 +269,7 @@ MODBUS_Status MODBUS_ReadSensor(uint8_t *MODBUS_Frame, uint8_t *MODBUS_ResponseF
 			break;
 
 		default:
-			break;
+			return MODBUS_SENSOR_READ_ERR;
 	}
 
 	return MODBUS_SENSOR_READ_OK;
@@ -209,20 +277,30 @@ MODBUS_Status MODBUS_ReadSensor(uint8_t *MODBUS_Frame, uint8_t *MODBUS_ResponseF
 
 void MODBUS_ProcessFrame(void)
 {
-	static uint8_t MODBUS_Frame[MODBUS_FRAME_SIZE];
-	MODBUS_Status status = MODBUS_ReadFrame(MODBUS_Frame);
+	uint8_t *MODBUS_Frame;
+	uint16_t length = 0;
 
-    if (!frame_ready)
-    {
-        if (status == MODBUS_RINGBUFFER_CLEAR)
-        {
+	// Half-duplex bus, the next request waits until our reply has left the line
+	if (tx_busy)
+	{
+		return;
+	}
+
+	MODBUS_Status status = MODBUS_ReadFrame(&MODBUS_Frame, &length);
+
+	if (status == MODBUS_FRAME_NOT_READY)
+	{
+		return;
+	}
+
+	if (status == MODBUS_RINGBUFFER_CLEAR)
+	{
 #if DEBUG > 1
-            	USART2_write_buffer("Clearing Ring Buffer");
+		USART2_write_buffer("Clearing Ring Buffer");
 #endif
-				MODBUS_ClearRingBuffer();
-        }
-        return;
-    }
+		MODBUS_ClearRingBuffer();
+		return;
+	}
 
 #if DEBUG > 0
 	uint8_t buffer[100];
@@ -232,35 +310,158 @@ void MODBUS_ProcessFrame(void)
 
     if (status == MODBUS_ADDR_VALID)
     {
-        MODBUS_ProcessValidFrame(MODBUS_Frame);
+        MODBUS_ProcessValidFrame(MODBUS_Frame, length);
     }
 
-    else
+    else if (status == MODBUS_FRAME_ERR)
     {
         MODBUS_ProcessInvalidFrame();
     }
 
-    uint8_t purge_byte;
-    MODBUS_RingBufferRead(&purge_byte);
-
-    frame_ready = 0;
+    MODBUS_ReleaseFrame();
 }
 
-MODBUS_Status MODBUS_TransmitResponse(uint8_t* MODBUS_ResponseFrame)
+MODBUS_Status MODBUS_TransmitResponse(uint8_t* MODBUS_ResponseFrame, uint16_t length)
 {
-	MODBUS_RE_TE_HIGH();
-	for (int i = 0; i < MODBUS_FRAME_SIZE - 1; ++i) // Response frame is always 7 bytes in this case
+	if (tx_busy)
+	{
+		return MODBUS_TX_BUSY;
+	}
+
+	for (uint16_t i = 0; i < length; ++i)
 	{
-		USART1_write(MODBUS_ResponseFrame[i]);
+		tx_buffer[i] = MODBUS_ResponseFrame[i];
 	}
-	MODBUS_RE_TE_LOW();
+
+	tx_busy = 1;
+	MODBUS_RE_TE_HIGH();
+	USART1_WriteDMA(tx_buffer, length);
+	USART1->CR1 |= USART_CR1_TCIE;
 
 	return MODBUS_FRAME_OK;
 }
 
-void MODBUS_ProcessValidFrame(uint8_t *MODBUS_Frame)
+uint8_t MODBUS_TransmitBusy()
+{
+	return tx_busy;
+}
+
+// A frame or a reply is on the line right now. TIM3 runs until t3.5 after
+// the last byte, with DMA the position also shows bytes before the first IDLE.
+uint8_t MODBUS_LineBusy()
+{
+#if MODBUS_RX_DMA
+	if (USART1_RxDMAPosition() != rx_head)
+	{
+		return 1;
+	}
+#endif
+
+	return tx_busy || rx_frame_length > 0 || (TIM3->CR1 & TIM_CR1_CEN);
+}
+
+// A frame is arriving, waiting to be processed or a reply is on the line
+uint8_t MODBUS_Busy()
+{
+	return MODBUS_LineBusy() || frame_queue_head != frame_queue_tail;
+}
+
+static uint8_t MODBUS_ExceptionCode(MODBUS_Status status)
 {
-	if (MODBUS_VerifyCRC(MODBUS_Frame) == MODBUS_CRC_INVALID)
+	switch (status)
+	{
+		case MODBUS_ILLEGAL_FUNCTION:
+			return MODBUS_EXC_ILLEGAL_FUNCTION;
+		case MODBUS_ILLEGAL_DATA_ADDRESS:
+			return MODBUS_EXC_ILLEGAL_DATA_ADDRESS;
+		case MODBUS_ILLEGAL_DATA_VALUE:
+			return MODBUS_EXC_ILLEGAL_DATA_VALUE;
+		default:
+			return MODBUS_EXC_DEVICE_FAILURE;
+	}
+}
+
+// Requests to the station address, returns the length of the response frame
+uint16_t MODBUS_ProcessStationRequest(uint8_t *MODBUS_Frame, uint16_t length, uint8_t *MODBUS_ResponseFrame)
+{
+	static uint16_t values[MODBUS_MAX_READ_REGISTERS];
+	uint8_t function = MODBUS_Frame[1];
+	uint16_t start = (MODBUS_Frame[2] << 8) | MODBUS_Frame[3];
+	uint16_t count = (MODBUS_Frame[4] << 8) | MODBUS_Frame[5];
+	MODBUS_Status status;
+
+	switch (function)
+	{
+		case MODBUS_READ_INPUT_REG:
+		case MODBUS_READ_HOLDING_REG:
+			if (length != MODBUS_FRAME_SIZE)
+			{
+				status = MODBUS_ILLEGAL_DATA_VALUE;
+			}
+			else if (function == MODBUS_READ_INPUT_REG)
+			{
+				status = MODBUS_ReadInputRegisters(start, count, values);
+			}
+			else
+			{
+				status = MODBUS_ReadHoldingRegisters(start, count, values);
+			}
+
+			if (status == MODBUS_FRAME_OK)
+			{
+				return MODBUS_Build_ResponseFrameRegisters(MODBUS_ResponseFrame, MODBUS_Frame[0], function, values, count);
+			}
+			break;
+
+		case MODBUS_WRITE_SINGLE_REG:
+			// Request carries the value where a read carries the count
+			if (length != MODBUS_FRAME_SIZE)
+			{
+				status = MODBUS_ILLEGAL_DATA_VALUE;
+			}
+			else
+			{
+				status = MODBUS_WriteHoldingRegisters(start, 1, &count);
+			}
+
+			if (status == MODBUS_FRAME_OK)
+			{
+				return MODBUS_Build_ResponseFrameWrite(MODBUS_ResponseFrame, MODBUS_Frame[0], function, start, count);
+			}
+			break;
+
+		case MODBUS_WRITE_MULTIPLE_REG:
+			// addr, function, start, count, byte count, values, CRC
+			if (length < 9 || MODBUS_Frame[6] != count * 2 || length != 9 + count * 2 || count > MODBUS_MAX_WRITE_REGISTERS)
+			{
+				status = MODBUS_ILLEGAL_DATA_VALUE;
+			}
+			else
+			{
+				for (uint16_t i = 0; i < count; ++i)
+				{
+					values[i] = (MODBUS_Frame[7 + 2 * i] << 8) | MODBUS_Frame[8 + 2 * i];
+				}
+				status = MODBUS_WriteHoldingRegisters(start, count, values);
+			}
+
+			if (status == MODBUS_FRAME_OK)
+			{
+				return MODBUS_Build_ResponseFrameWrite(MODBUS_ResponseFrame, MODBUS_Frame[0], function, start, count);
+			}
+			break;
+
+		default:
+			status = MODBUS_ILLEGAL_FUNCTION;
+			break;
+	}
+
+	return MODBUS_Build_ExceptionFrame(MODBUS_ResponseFrame, MODBUS_Frame[0], function, MODBUS_ExceptionCode(status));
+}
+
+void MODBUS_ProcessValidFrame(uint8_t *MODBUS_Frame, uint16_t length)
+{
+	if (MODBUS_VerifyCRC(MODBUS_Frame, length) == MODBUS_CRC_INVALID)
 	{
 #if DEBUG > 1
 	    char debugBuffer[100];
@@ -270,16 +471,30 @@ void MODBUS_ProcessValidFrame(uint8_t *MODBUS_Frame)
 		return;
 	}
 
+	if (MODBUS_Frame[0] == CONFIG_Get()->station_address)
+	{
+		uint8_t MODBUS_ResponseFrame[MODBUS_MAX_FRAME_SIZE];
+		uint16_t response_length = MODBUS_ProcessStationRequest(MODBUS_Frame, length, MODBUS_ResponseFrame);
+		MODBUS_TransmitResponse(MODBUS_ResponseFrame, response_length);
+		return;
+	}
+
 	uint8_t MODBUS_ResponseFrame[MODBUS_FRAME_SIZE];
-    MODBUS_ReadSensor(MODBUS_Frame, MODBUS_ResponseFrame);
-    MODBUS_TransmitResponse(MODBUS_ResponseFrame);
+    if (MODBUS_ReadSensor(MODBUS_Frame, MODBUS_ResponseFrame) != MODBUS_SENSOR_READ_OK)
+    {
+#if DEBUG > 1
+    	USART2_write_buffer("No cached reading for slave");
+#endif
+    	return;
+    }
+    MODBUS_TransmitResponse(MODBUS_ResponseFrame, MODBUS_FRAME_SIZE - 1); // Response frame is always 7 bytes in this case
 
 #if DEBUG > 1
     char debugBuffer[100];
     snprintf(debugBuffer, sizeof(debugBuffer), "Generated frame:");
     USART2_write_buffer(debugBuffer);
 
-    for (int i = 0; i < MODBUS_FRAME_SIZE; ++i)
+    for (int i = 0; i < length; ++i)
     {
         snprintf(debugBuffer, sizeof(debugBuffer), "%.2x ", MODBUS_Frame[i]);
         USART2_write_buffer(debugBuffer);
@@ -291,11 +506,11 @@ void MODBUS_ProcessInvalidFrame(void)
 {
 #if DEBUG > 1
     char debugBuffer[100];
-    snprintf(debugBuffer, sizeof(debugBuffer), "Invalid address!");
+    snprintf(debugBuffer, sizeof(debugBuffer), "Invalid frame!");
     USART2_write_buffer(debugBuffer);
 #endif
 
-	MODBUS_ClearRingBuffer();
+	buffer_OVF = 0;
 }
 
 MODBUS_Status MODBUS_RingBufferRead(uint8_t *data)
@@ -312,7 +527,10 @@ MODBUS_Status MODBUS_RingBufferRead(uint8_t *data)
 
 MODBUS_Status MODBUS_ClearRingBuffer()
 {
-    rx_tail = rx_head;
+    __disable_irq();
+    frame_queue_tail = frame_queue_head;
+    rx_tail = rx_frame_start;
+    __enable_irq();
 
 	if (buffer_OVF)
 	{
@@ -359,22 +577,235 @@ MODBUS_Status MODBUS_Build_ResponseFrameRaw(uint8_t* MODBUS_Frame, uint8_t slave
 	return MODBUS_FRAME_OK;
 }
 
+uint16_t MODBUS_Build_ResponseFrameRegisters(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint16_t *values, uint16_t count)
+{
+	uint16_t MODBUS_FrameCRC = 0x0000;
+	uint16_t length = 3;
+
+	MODBUS_Frame[0] = slave_addr;
+	MODBUS_Frame[1] = function;
+	MODBUS_Frame[2] = count * 2;
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		MODBUS_Frame[length++] = values[i] >> 8;
+		MODBUS_Frame[length++] = values[i] & 0x00FF;
+	}
+
+	MODBUS_FrameCRC = CRC16(MODBUS_Frame, length);
+	MODBUS_Frame[length++] = MODBUS_FrameCRC & 0x00FF;
+	MODBUS_Frame[length++] = MODBUS_FrameCRC >> 8;
+
+	return length;
+}
+
+// Response to 0x06 and 0x10: start address and the written value or count
+uint16_t MODBUS_Build_ResponseFrameWrite(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint16_t start, uint16_t value)
+{
+	uint16_t MODBUS_FrameCRC = 0x0000;
+
+	MODBUS_Frame[0] = slave_addr;
+	MODBUS_Frame[1] = function;
+	MODBUS_Frame[2] = start >> 8;
+	MODBUS_Frame[3] = start & 0x00FF;
+	MODBUS_Frame[4] = value >> 8;
+	MODBUS_Frame[5] = value & 0x00FF;
+
+	MODBUS_FrameCRC = CRC16(MODBUS_Frame, 6);
+	MODBUS_Frame[6] = MODBUS_FrameCRC & 0x00FF;
+	MODBUS_Frame[7] = MODBUS_FrameCRC >> 8;
+
+	return 8;
+}
+
+uint16_t MODBUS_Build_ExceptionFrame(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint8_t exception_code)
+{
+	uint16_t MODBUS_FrameCRC = 0x0000;
+
+	MODBUS_Frame[0] = slave_addr;
+	MODBUS_Frame[1] = function | MODBUS_EXCEPTION_FLAG;
+	MODBUS_Frame[2] = exception_code;
+
+	MODBUS_FrameCRC = CRC16(MODBUS_Frame, 3);
+	MODBUS_Frame[3] = MODBUS_FrameCRC & 0x00FF;
+	MODBUS_Frame[4] = MODBUS_FrameCRC >> 8;
+
+	return 5;
+}
+
+static void MODBUS_QueueFrame()
+{
+	if (rx_frame_length > 0)
+	{
+		uint8_t next_head = (frame_queue_head + 1) % MODBUS_FRAME_QUEUE_SIZE;
+
+		if (next_head != frame_queue_tail)
+		{
+			frame_queue[frame_queue_head].start = rx_frame_start;
+			frame_queue[frame_queue_head].length = rx_frame_length;
+			frame_queue[frame_queue_head].flags = rx_frame_flags;
+			frame_queue_head = next_head;
+			EVENT_Post(EVENT_MODBUS_FRAME);
+		}
+
+		else
+		{
+			// No room to describe the frame, drop its bytes
+#if MODBUS_RX_DMA
+			buffer_OVF = 1;
+#else
+			rx_head = rx_frame_start;
+#endif
+		}
+	}
+
+	rx_frame_start = rx_head;
+	rx_frame_length = 0;
+	rx_frame_flags = 0;
+	rx_t15_expired = 0;
+}
+
+// Last stop bit is out, hand the bus back to the master
+static void MODBUS_TxCompleteHandler()
+{
+	if ((USART1->CR1 & USART_CR1_TCIE) && (USART1->SR & USART_SR_TC))
+	{
+		USART1->CR1 &= ~USART_CR1_TCIE;
+		USART1_StopTxDMA();
+		MODBUS_RE_TE_LOW();
+		tx_busy = 0;
+		EVENT_Post(EVENT_MODBUS_FRAME); // Requests that queued up behind the reply
+	}
+}
+
+#if MODBUS_RX_DMA
+
+void MODBUS_IRQHandler()
+{
+    MODBUS_TxCompleteHandler();
+
+    if (USART1->SR & USART_SR_IDLE)
+    {
+        (void)USART1->DR; // SR read followed by DR read clears IDLE
+
+        if (TIM3->SR & (TIM_SR_UIF | TIM_SR_CC1IF))
+        {
+        	MODBUS_TimerIRQHandler();
+        }
+
+        // Bytes arrived after t1.5 of silence but before t3.5
+        if (rx_t15_expired)
+        {
+        	rx_frame_flags |= MODBUS_SLICE_BROKEN;
+        }
+
+        rx_head = USART1_RxDMAPosition();
+        rx_frame_length = (rx_head - rx_frame_start + RX_BUFFER_SIZE) % RX_BUFFER_SIZE;
+
+        if (rx_frame_length > MODBUS_MAX_FRAME_SIZE)
+        {
+        	rx_frame_flags |= MODBUS_SLICE_BROKEN;
+        }
+
+        rx_t15_expired = 0;
+        TIM3_Restart();
+    }
+
+    // EIE is set in USART1_init, clear overrun/framing/noise errors here
+    if (USART1->SR & (USART_SR_ORE | USART_SR_FE | USART_SR_NE))
+    {
+        (void)USART1->DR;
+        rx_frame_flags |= MODBUS_SLICE_BROKEN;
+    }
+}
+
+// Timer runs from the IDLE event, so the DMA position tells whether more
+// bytes arrived in the meantime.
+void MODBUS_TimerIRQHandler()
+{
+	if (TIM3->SR & TIM_SR_CC1IF) // t1.5 of silence plus one character
+	{
+		TIM3->SR &= ~TIM_SR_CC1IF;
+
+		if (USART1_RxDMAPosition() != rx_head)
+		{
+			// A byte started within t1.5, the next IDLE restarts the timer
+			TIM3_Stop();
+			TIM3->SR = 0;
+			return;
+		}
+
+		rx_t15_expired = 1;
+	}
+
+	if (TIM3->SR & TIM_SR_UIF) // t3.5 of silence
+	{
+		TIM3->SR &= ~TIM_SR_UIF;
+
+		if (USART1_RxDMAPosition() != rx_head)
+		{
+			// Late bytes, the frame is closed by the IDLE that follows them
+			return;
+		}
+
+		MODBUS_QueueFrame();
+	}
+}
+
+#else
+
 void MODBUS_IRQHandler()
 {
+    MODBUS_TxCompleteHandler();
+
     if (USART1->SR & USART_SR_RXNE)
     {
         uint8_t data = USART1->DR;
         uint16_t next_head = (rx_head + 1) % RX_BUFFER_SIZE;
 
+        // Let a pending silence event land before the timer is restarted
+        if (TIM3->SR & (TIM_SR_UIF | TIM_SR_CC1IF))
+        {
+        	MODBUS_TimerIRQHandler();
+        }
+
+        // A gap longer than t1.5 inside a frame makes the whole frame invalid
+        if (rx_t15_expired && rx_frame_length > 0)
+        {
+        	rx_frame_flags |= MODBUS_SLICE_BROKEN;
+        }
+
         if (next_head != rx_tail)
         {
             rx_buffer[rx_head] = data;
             rx_head = next_head;
+            rx_frame_length++;
         }
 
         else
         {
         	buffer_OVF = 1;
+        	rx_frame_flags |= MODBUS_SLICE_BROKEN;
         }
+
+        rx_t15_expired = 0;
+        TIM3_Restart();
     }
 }
+
+void MODBUS_TimerIRQHandler()
+{
+	if (TIM3->SR & TIM_SR_CC1IF) // t1.5 of silence plus one character
+	{
+		TIM3->SR &= ~TIM_SR_CC1IF;
+		rx_t15_expired = 1;
+	}
+
+	if (TIM3->SR & TIM_SR_UIF) // t3.5 of silence, frame complete
+	{
+		TIM3->SR &= ~TIM_SR_UIF;
+		MODBUS_QueueFrame();
+	}
+}
+
+#endif
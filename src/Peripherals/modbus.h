@@ -11,12 +11,45 @@
 #include "stm32l1xx.h"
 #include <stdio.h>
 
-#define SLAVE_COUNT 4
+#define MODBUS_STATION_ADDRESS 0x10 // Default address of the station-wide register map
 #define MODBUS_FRAME_SIZE 8
-#define RX_BUFFER_SIZE 128
+#define MODBUS_MIN_FRAME_SIZE 4
+#define MODBUS_MAX_FRAME_SIZE 256
+#define RX_BUFFER_SIZE 512
+#define MODBUS_FRAME_QUEUE_SIZE 4
 
+#define MODBUS_BAUDRATE 9600
+#define MODBUS_CHAR_BITS 11 // start + 8 data + parity/stop + stop
+
+// 1: USART1 RX through circular DMA and the IDLE interrupt, 0: RXNE interrupt per byte
+#define MODBUS_RX_DMA 1
+
+#define MODBUS_T10_US ((MODBUS_CHAR_BITS * 1000000UL) / MODBUS_BAUDRATE)
+
+// Inter-character (t1.5) and inter-frame (t3.5) silences in microseconds.
+// Above 19200 baud the spec fixes them to 750 us and 1750 us.
+#if MODBUS_BAUDRATE > 19200
+#define MODBUS_T15_US 750
+#define MODBUS_T35_US 1750
+#else
+#define MODBUS_T15_US ((MODBUS_CHAR_BITS * 1000000UL * 3) / (MODBUS_BAUDRATE * 2))
+#define MODBUS_T35_US ((MODBUS_CHAR_BITS * 1000000UL * 7) / (MODBUS_BAUDRATE * 2))
+#endif
+
+#define MODBUS_SLICE_BROKEN 0x01 // t1.5 violated or bytes lost, discard
+
+#define MODBUS_READ_HOLDING_REG 0x03
 #define MODBUS_READ_INPUT_REG 0x04
+#define MODBUS_WRITE_SINGLE_REG 0x06
+#define MODBUS_WRITE_MULTIPLE_REG 0x10
+#define MODBUS_EXCEPTION_FLAG 0x80
+
+#define MODBUS_EXC_ILLEGAL_FUNCTION 0x01
+#define MODBUS_EXC_ILLEGAL_DATA_ADDRESS 0x02
+#define MODBUS_EXC_ILLEGAL_DATA_VALUE 0x03
+#define MODBUS_EXC_DEVICE_FAILURE 0x04
 #define MODBUS_CLEAR_BUFFER_REG 0xFF
+#define MODBUS_REG_SAMPLE_AGE 0x10 // Age of the cached reading in ms
 
 typedef enum {
     MODBUS_ADDR_INVALID = 0,
@@ -31,9 +64,21 @@ typedef enum {
 	MODBUS_RINGBUFFER_NOT_EMPTY = 9,
 	MODBUS_RINGBUFFER_CLEAR = 10,
 	MODBUS_RESPONSE_FRAME_OK = 11,
-	MODBUS_FRAME_NOT_READY = 12
+	MODBUS_FRAME_NOT_READY = 12,
+	MODBUS_TX_BUSY = 13,
+	MODBUS_ILLEGAL_FUNCTION = 14,
+	MODBUS_ILLEGAL_DATA_ADDRESS = 15,
+	MODBUS_ILLEGAL_DATA_VALUE = 16,
+	MODBUS_DEVICE_FAILURE = 17
 } MODBUS_Status;
 
+// One received frame, delimited by t3.5 of silence, inside rx_buffer
+typedef struct MODBUS_FrameSlice {
+	uint16_t start;
+	uint16_t length;
+	uint8_t flags;
+} MODBUS_FrameSlice;
+
 typedef struct MODBUS_Reading {
 	uint16_t temperature;
 	uint16_t humidity;
@@ -41,22 +86,33 @@ typedef struct MODBUS_Reading {
     uint16_t tvoc_ppb;
     uint16_t co2_eq_ppm;
     uint16_t raw_reading[5];
+    int32_t value[2]; // Engineering values after the sampler's filters
 } MODBUS_Reading;
 
+void MODBUS_init();
 void MODBUS_IRQHandler();
+void MODBUS_TimerIRQHandler();
 void MODBUS_ProcessFrame();
 void MODBUS_DiscardFrame();
-void MODBUS_ProcessValidFrame(uint8_t *MODBUS_Frame);
+void MODBUS_ProcessValidFrame(uint8_t *MODBUS_Frame, uint16_t length);
 void MODBUS_ProcessInvalidFrame();
-MODBUS_Status MODBUS_ReadFrame(uint8_t *MODBUS_Frame);
+MODBUS_Status MODBUS_ReadFrame(uint8_t **MODBUS_Frame, uint16_t *length);
+void MODBUS_ReleaseFrame();
 uint16_t CRC16(uint8_t *nData, uint16_t wLength);
 MODBUS_Status MODBUS_RingBufferRead(uint8_t *data);
 MODBUS_Status MODBUS_ClearRingBuffer();
 MODBUS_Status MODBUS_CheckAddress(uint8_t address);
-MODBUS_Status MODBUS_VerifyCRC(uint8_t *MODBUS_Frame);
+MODBUS_Status MODBUS_VerifyCRC(uint8_t *MODBUS_Frame, uint16_t length);
 MODBUS_Status MODBUS_ReadSensor(uint8_t *MODBUS_Frame, uint8_t *MODBUS_ResponseFrame);
 MODBUS_Status MODBUS_Build_ResponseFrameReading(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint16_t reading);
 MODBUS_Status MODBUS_Build_ResponseFrameRaw(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t raw_data1, uint8_t raw_data2);
-MODBUS_Status MODBUS_TransmitResponse(uint8_t* MODBUS_ResponseFrame);
+uint16_t MODBUS_ProcessStationRequest(uint8_t *MODBUS_Frame, uint16_t length, uint8_t *MODBUS_ResponseFrame);
+uint16_t MODBUS_Build_ResponseFrameRegisters(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint16_t *values, uint16_t count);
+uint16_t MODBUS_Build_ResponseFrameWrite(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint16_t start, uint16_t value);
+uint16_t MODBUS_Build_ExceptionFrame(uint8_t* MODBUS_Frame, uint8_t slave_addr, uint8_t function, uint8_t exception_code);
+MODBUS_Status MODBUS_TransmitResponse(uint8_t* MODBUS_ResponseFrame, uint16_t length);
+uint8_t MODBUS_TransmitBusy();
+uint8_t MODBUS_Busy();
+uint8_t MODBUS_LineBusy();
 
 #endif /* PERIPHERALS_MODBUS_H_ */
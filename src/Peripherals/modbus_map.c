@@ -0,0 +1,415 @@
+/*
+ * modbus_map.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "modbus_map.h"
+#include "sampler.h"
+#include "config.h"
+#include "dht22.h"
+#include "adc.h"
+#include "power.h"
+#include "sgp30_humidity.h"
+
+// Sensor block n+1 belongs to sensor index n (CONFIG_SENSOR_*)
+#define MAP_SENSOR_BLOCKS CONFIG_SENSOR_COUNT
+
+static uint16_t MAP_SensorValue(uint8_t sensor, const MODBUS_Reading *reading, uint8_t offset)
+{
+	switch (sensor)
+	{
+		case CONFIG_SENSOR_LMT84LP:
+		case CONFIG_SENSOR_NSL19M51:
+			if (offset == MAP_REG_VALUE0) // 0.01 C or 0.1 lux
+			{
+				return (uint16_t)reading->value[0];
+			}
+			else if (offset == MAP_REG_RAW0)
+			{
+				return reading->raw_reading[0];
+			}
+			else if (offset == MAP_REG_RAW1) // Oversampled, 16-bit scale
+			{
+				return reading->raw_reading[1];
+			}
+			break;
+
+		case CONFIG_SENSOR_SGP30:
+			if (offset == MAP_REG_VALUE0 || offset == MAP_REG_VALUE1) // CO2eq ppm, TVOC ppb
+			{
+				return (uint16_t)reading->value[offset - MAP_REG_VALUE0];
+			}
+			break;
+
+		case CONFIG_SENSOR_DHT22:
+			if (offset == MAP_REG_RAW0)
+			{
+				return DHT22_Humidity(reading);
+			}
+			else if (offset == MAP_REG_RAW1)
+			{
+				return (reading->raw_reading[2] << 8) | reading->raw_reading[3];
+			}
+			else if (offset == MAP_REG_VALUE0 || offset == MAP_REG_VALUE1) // RH in 0.1 %, temperature in 0.1 C two's complement
+			{
+				return (uint16_t)reading->value[offset - MAP_REG_VALUE0];
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return MAP_REG_NOT_AVAILABLE;
+}
+
+// Engineering values get the per-channel calibration offset from the config
+static uint16_t MAP_CalibratedValue(uint8_t sensor, uint8_t offset, uint16_t value)
+{
+	if (value == MAP_REG_NOT_AVAILABLE || (offset != MAP_REG_VALUE0 && offset != MAP_REG_VALUE1))
+	{
+		return value;
+	}
+
+	return (uint16_t)((int16_t)value + CONFIG_Get()->sensor[sensor].calibration_offset[offset - MAP_REG_VALUE0]);
+}
+
+static uint16_t MAP_ReadDHT22Diagnostic(uint8_t offset)
+{
+	DHT22_Diagnostics diagnostics;
+
+	DHT22_GetDiagnostics(&diagnostics);
+
+	switch (offset)
+	{
+		case MAP_REG_DHT22_ERROR:
+			return diagnostics.error;
+		case MAP_REG_DHT22_OUTLIERS:
+			return diagnostics.outlier_count;
+		case MAP_REG_DHT22_OUTLIER_MASK0:
+			return diagnostics.outlier[0];
+		case MAP_REG_DHT22_OUTLIER_MASK1:
+			return (diagnostics.outlier[1] << 8) | diagnostics.outlier[2];
+		case MAP_REG_DHT22_OUTLIER_MASK2:
+			return (diagnostics.outlier[3] << 8) | diagnostics.outlier[4];
+		case MAP_REG_DHT22_RESPONSE_US:
+			return diagnostics.response_us;
+		case MAP_REG_DHT22_MIN_PERIOD_US:
+			return diagnostics.min_period_us;
+		default:
+			return diagnostics.max_period_us;
+	}
+}
+
+static uint16_t MAP_ReadStationRegister(uint8_t offset)
+{
+	uint16_t mask = 0;
+	POWER_Stats stats;
+
+	switch (offset)
+	{
+		case MAP_REG_STATION_VALID_MASK:
+			for (uint8_t i = 0; i < MAP_SENSOR_BLOCKS; ++i)
+			{
+				if (SAMPLER_GetStatusWord(i) & SAMPLER_STATUS_VALID)
+				{
+					mask |= 1 << i;
+				}
+			}
+			return mask;
+
+		case MAP_REG_STATION_SENSOR_COUNT:
+			return MAP_SENSOR_BLOCKS;
+
+		case MAP_REG_STATION_MAP_VERSION:
+			return MAP_VERSION;
+
+		case MAP_REG_STATION_VREFINT_RAW:
+			return ADC_GetSample(ADC_SCAN_VREFINT);
+
+		case MAP_REG_STATION_MCU_TEMP_RAW:
+			return ADC_GetSample(ADC_SCAN_TEMPSENSOR);
+
+		case MAP_REG_STATION_VDDA_MV:
+			return ADC_GetVdda();
+
+		case MAP_REG_STATION_MCU_TEMP:
+			return (uint16_t)ADC_GetMcuTemperature();
+
+		case MAP_REG_STATION_RUN_RESIDENCY:
+			return POWER_GetResidency(POWER_RUN);
+
+		case MAP_REG_STATION_SLEEP_RESIDENCY:
+			return POWER_GetResidency(POWER_SLEEP);
+
+		case MAP_REG_STATION_STOP_RESIDENCY:
+			return POWER_GetResidency(POWER_STOP);
+
+		case MAP_REG_STATION_STOP_COUNT:
+			POWER_GetStats(&stats);
+			return (uint16_t)stats.stop_count;
+
+		case MAP_REG_STATION_RX_WAKEUPS:
+			POWER_GetStats(&stats);
+			return (uint16_t)stats.rx_wakeups;
+
+		case MAP_REG_STATION_CONFIG_SAVE:
+			return CONFIG_GetSaveState();
+
+		case MAP_REG_STATION_HUMIDITY_ERRORS:
+			return (uint16_t)SGP30_HUMIDITY_Failures();
+
+		default:
+			return MAP_REG_NOT_AVAILABLE;
+	}
+}
+
+// Fills values[] with count registers starting at start. A whole block is
+// fetched from the sampler once, so registers of one sensor always come from
+// the same reading.
+MODBUS_Status MODBUS_ReadInputRegisters(uint16_t start, uint16_t count, uint16_t *values)
+{
+	MODBUS_Reading reading;
+	uint16_t age_ms = 0;
+	uint16_t cached_block = 0xFFFF;
+	SAMPLER_Status cached_status = SAMPLER_NO_DATA;
+
+	if (count == 0 || count > MODBUS_MAX_READ_REGISTERS)
+	{
+		return MODBUS_ILLEGAL_DATA_VALUE;
+	}
+
+	if (start + count > MAP_INPUT_REG_COUNT)
+	{
+		return MODBUS_ILLEGAL_DATA_ADDRESS;
+	}
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		uint16_t reg = start + i;
+		uint16_t block = reg / MAP_BLOCK_SIZE;
+		uint8_t offset = reg % MAP_BLOCK_SIZE;
+
+		if (block == 0)
+		{
+			values[i] = MAP_ReadStationRegister(offset);
+			continue;
+		}
+
+		uint8_t sensor = block - 1;
+
+		if (block != cached_block)
+		{
+			cached_status = SAMPLER_GetReading(sensor, &reading, &age_ms);
+			cached_block = block;
+		}
+
+		if (offset == MAP_REG_STATUS)
+		{
+			values[i] = SAMPLER_GetStatusWord(sensor);
+		}
+
+		else if (sensor == CONFIG_SENSOR_DHT22 && offset >= MAP_REG_DHT22_ERROR)
+		{
+			values[i] = MAP_ReadDHT22Diagnostic(offset);
+		}
+
+		else if (cached_status != SAMPLER_OK)
+		{
+			values[i] = MAP_REG_NOT_AVAILABLE;
+		}
+
+		else if (offset == MAP_REG_AGE_MS)
+		{
+			values[i] = age_ms;
+		}
+
+		else
+		{
+			values[i] = MAP_CalibratedValue(sensor, offset, MAP_SensorValue(sensor, &reading, offset));
+		}
+	}
+
+	return MODBUS_FRAME_OK;
+}
+
+static MODBUS_Status MAP_GetHolding(const STATION_Config *config, uint16_t reg, uint16_t *value)
+{
+	uint16_t block = reg / MAP_BLOCK_SIZE;
+	uint8_t offset = reg % MAP_BLOCK_SIZE;
+
+	if (block == 0)
+	{
+		switch (offset)
+		{
+			case MAP_HREG_ENABLE_MASK:
+				*value = config->enable_mask;
+				return MODBUS_FRAME_OK;
+			case MAP_HREG_ADC_SAMPLE_TIME:
+				*value = config->adc_sample_time;
+				return MODBUS_FRAME_OK;
+			case MAP_HREG_STATION_ADDRESS:
+				*value = config->station_address;
+				return MODBUS_FRAME_OK;
+			case MAP_HREG_SAVE_CONFIG:
+				*value = 0;
+				return MODBUS_FRAME_OK;
+			default:
+				return MODBUS_ILLEGAL_DATA_ADDRESS;
+		}
+	}
+
+	const CONFIG_Sensor *sensor = &config->sensor[block - 1];
+
+	switch (offset)
+	{
+		case MAP_HREG_INTERVAL_MS:
+			*value = sensor->interval_ms;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_OVERSAMPLING:
+			*value = sensor->oversampling;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_FILTER_SHIFT:
+			*value = sensor->filter_shift;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_MODBUS_ADDRESS:
+			*value = sensor->modbus_address;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_CAL_OFFSET0:
+		case MAP_HREG_CAL_OFFSET1:
+			*value = (uint16_t)sensor->calibration_offset[offset - MAP_HREG_CAL_OFFSET0];
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_MEDIAN_LENGTH:
+			*value = sensor->median_length;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_BOXCAR_LENGTH:
+			*value = sensor->boxcar_length;
+			return MODBUS_FRAME_OK;
+		default:
+			return MODBUS_ILLEGAL_DATA_ADDRESS;
+	}
+}
+
+static MODBUS_Status MAP_SetHolding(STATION_Config *config, uint16_t reg, uint16_t value, uint8_t *save)
+{
+	uint16_t block = reg / MAP_BLOCK_SIZE;
+	uint8_t offset = reg % MAP_BLOCK_SIZE;
+
+	if (block == 0)
+	{
+		switch (offset)
+		{
+			case MAP_HREG_ENABLE_MASK:
+				config->enable_mask = value;
+				return MODBUS_FRAME_OK;
+			case MAP_HREG_ADC_SAMPLE_TIME:
+				config->adc_sample_time = value;
+				return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+			case MAP_HREG_STATION_ADDRESS:
+				config->station_address = value;
+				return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+			case MAP_HREG_SAVE_CONFIG:
+				*save = 1;
+				return (value != MAP_SAVE_CONFIG_KEY) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+			default:
+				return MODBUS_ILLEGAL_DATA_ADDRESS;
+		}
+	}
+
+	CONFIG_Sensor *sensor = &config->sensor[block - 1];
+
+	switch (offset)
+	{
+		case MAP_HREG_INTERVAL_MS:
+			sensor->interval_ms = value;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_OVERSAMPLING:
+			sensor->oversampling = value;
+			return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+		case MAP_HREG_FILTER_SHIFT:
+			sensor->filter_shift = value;
+			return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+		case MAP_HREG_MODBUS_ADDRESS:
+			sensor->modbus_address = value;
+			return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+		case MAP_HREG_CAL_OFFSET0:
+		case MAP_HREG_CAL_OFFSET1:
+			sensor->calibration_offset[offset - MAP_HREG_CAL_OFFSET0] = (int16_t)value;
+			return MODBUS_FRAME_OK;
+		case MAP_HREG_MEDIAN_LENGTH:
+			sensor->median_length = value;
+			return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+		case MAP_HREG_BOXCAR_LENGTH:
+			sensor->boxcar_length = value;
+			return (value > 0xFF) ? MODBUS_ILLEGAL_DATA_VALUE : MODBUS_FRAME_OK;
+		default:
+			return MODBUS_ILLEGAL_DATA_ADDRESS;
+	}
+}
+
+MODBUS_Status MODBUS_ReadHoldingRegisters(uint16_t start, uint16_t count, uint16_t *values)
+{
+	const STATION_Config *config = CONFIG_Get();
+
+	if (count == 0 || count > MODBUS_MAX_READ_REGISTERS)
+	{
+		return MODBUS_ILLEGAL_DATA_VALUE;
+	}
+
+	if (start + count > MAP_HOLDING_REG_COUNT)
+	{
+		return MODBUS_ILLEGAL_DATA_ADDRESS;
+	}
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		if (MAP_GetHolding(config, start + i, &values[i]) != MODBUS_FRAME_OK)
+		{
+			values[i] = MAP_REG_NOT_AVAILABLE;
+		}
+	}
+
+	return MODBUS_FRAME_OK;
+}
+
+// Changes are made on a copy and only applied when the whole write is valid.
+// The config is stored in EEPROM only when the save register is written, and
+// only after the reply has gone out (CONFIG_Process() from the main loop).
+MODBUS_Status MODBUS_WriteHoldingRegisters(uint16_t start, uint16_t count, const uint16_t *values)
+{
+	STATION_Config config = *CONFIG_Get();
+	uint8_t save = 0;
+
+	if (count == 0 || count > MODBUS_MAX_WRITE_REGISTERS)
+	{
+		return MODBUS_ILLEGAL_DATA_VALUE;
+	}
+
+	if (start + count > MAP_HOLDING_REG_COUNT)
+	{
+		return MODBUS_ILLEGAL_DATA_ADDRESS;
+	}
+
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		MODBUS_Status status = MAP_SetHolding(&config, start + i, values[i], &save);
+		if (status != MODBUS_FRAME_OK)
+		{
+			return status;
+		}
+	}
+
+	if (CONFIG_Apply(&config) != CONFIG_OK)
+	{
+		return MODBUS_ILLEGAL_DATA_VALUE;
+	}
+
+	if (save)
+	{
+		CONFIG_RequestSave();
+	}
+
+	return MODBUS_FRAME_OK;
+}
@@ -0,0 +1,103 @@
+/*
+ * modbus_map.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef PERIPHERALS_MODBUS_MAP_H_
+#define PERIPHERALS_MODBUS_MAP_H_
+
+#include "stm32l1xx.h"
+#include "modbus.h"
+
+/*
+ * Station-wide input register map, served at MODBUS_STATION_ADDRESS.
+ *
+ * 0x0000  Station block
+ * 0x0010  LMT84LP block
+ * 0x0020  NSL19M51 block
+ * 0x0030  SGP30 block
+ * 0x0040  DHT22 block
+ *
+ * Every sensor block has the same layout, see MAP_REG_* offsets. Registers
+ * inside the map without a value read as MAP_REG_NOT_AVAILABLE.
+ */
+#define MAP_BLOCK_SIZE 0x10
+#define MAP_STATION_BLOCK 0x0000
+#define MAP_LMT84LP_BLOCK 0x0010
+#define MAP_NSL19M51_BLOCK 0x0020
+#define MAP_SGP30_BLOCK 0x0030
+#define MAP_DHT22_BLOCK 0x0040
+#define MAP_INPUT_REG_COUNT 0x0050
+
+// Station block
+#define MAP_REG_STATION_VALID_MASK 0x00 // Bit n set when sensor block n+1 holds a reading
+#define MAP_REG_STATION_SENSOR_COUNT 0x01
+#define MAP_REG_STATION_MAP_VERSION 0x02
+#define MAP_REG_STATION_VREFINT_RAW 0x03 // Latest ADC scan, ADC counts
+#define MAP_REG_STATION_MCU_TEMP_RAW 0x04
+#define MAP_REG_STATION_VDDA_MV 0x05 // From VREFINT and its factory calibration
+#define MAP_REG_STATION_MCU_TEMP 0x06 // 0.01 C, signed
+#define MAP_REG_STATION_RUN_RESIDENCY 0x07 // Share of time since boot, 0.1 %
+#define MAP_REG_STATION_SLEEP_RESIDENCY 0x08
+#define MAP_REG_STATION_STOP_RESIDENCY 0x09
+#define MAP_REG_STATION_STOP_COUNT 0x0A // Stop mode entries, wraps
+#define MAP_REG_STATION_RX_WAKEUPS 0x0B // Stop mode left on a Modbus start bit, wraps
+#define MAP_REG_STATION_CONFIG_SAVE 0x0C // CONFIG_SAVE_* outcome of the last save request
+#define MAP_REG_STATION_HUMIDITY_ERRORS 0x0D // Failed SGP30 humidity pushes, wraps
+
+// Sensor block offsets
+#define MAP_REG_STATUS 0x00 // SAMPLER_STATUS_* bits
+#define MAP_REG_AGE_MS 0x01 // Age of the cached reading, saturates at 0xFFFF
+#define MAP_REG_RAW0 0x02
+#define MAP_REG_RAW1 0x03
+#define MAP_REG_VALUE0 0x04
+#define MAP_REG_VALUE1 0x05
+
+// DHT22 block, timing of the last conversion (DHT22_Diagnostics)
+#define MAP_REG_DHT22_ERROR 0x08 // DHT22_ERR_*
+#define MAP_REG_DHT22_OUTLIERS 0x09
+#define MAP_REG_DHT22_OUTLIER_MASK0 0x0A // Data bits 39:32
+#define MAP_REG_DHT22_OUTLIER_MASK1 0x0B // Data bits 31:16
+#define MAP_REG_DHT22_OUTLIER_MASK2 0x0C // Data bits 15:0
+#define MAP_REG_DHT22_RESPONSE_US 0x0D
+#define MAP_REG_DHT22_MIN_PERIOD_US 0x0E
+#define MAP_REG_DHT22_MAX_PERIOD_US 0x0F
+
+/*
+ * Holding registers use the same block layout and configure the station
+ * live. A write is validated as a whole and rejected with an exception if
+ * any value is out of range, see config.h for the limits.
+ */
+#define MAP_HOLDING_REG_COUNT 0x0050
+
+// Station block
+#define MAP_HREG_ENABLE_MASK 0x00 // Bit n enables sensor block n+1
+#define MAP_HREG_ADC_SAMPLE_TIME 0x01 // 0 = 4 ... 7 = 384 ADC cycles
+#define MAP_HREG_STATION_ADDRESS 0x02
+#define MAP_HREG_SAVE_CONFIG 0x03 // Write MAP_SAVE_CONFIG_KEY to store the config in EEPROM after the reply
+
+// Sensor block offsets
+#define MAP_HREG_INTERVAL_MS 0x00
+#define MAP_HREG_OVERSAMPLING 0x01 // log2 of accumulated samples
+#define MAP_HREG_FILTER_SHIFT 0x02 // EMA alpha = 1 / 2^n, 0 = off
+#define MAP_HREG_MODBUS_ADDRESS 0x03
+#define MAP_HREG_CAL_OFFSET0 0x04 // Signed, added to MAP_REG_VALUE0
+#define MAP_HREG_CAL_OFFSET1 0x05 // Signed, added to MAP_REG_VALUE1
+#define MAP_HREG_MEDIAN_LENGTH 0x06 // Median spike filter window, 0/1 = off, 3 or 5
+#define MAP_HREG_BOXCAR_LENGTH 0x07 // Moving average window, 0/1 = off, up to 8
+
+#define MAP_SAVE_CONFIG_KEY 0x5A5A
+
+#define MAP_VERSION 8
+#define MAP_REG_NOT_AVAILABLE 0x8000
+
+#define MODBUS_MAX_READ_REGISTERS 125
+#define MODBUS_MAX_WRITE_REGISTERS 123
+
+MODBUS_Status MODBUS_ReadInputRegisters(uint16_t start, uint16_t count, uint16_t *values);
+MODBUS_Status MODBUS_ReadHoldingRegisters(uint16_t start, uint16_t count, uint16_t *values);
+MODBUS_Status MODBUS_WriteHoldingRegisters(uint16_t start, uint16_t count, const uint16_t *values);
+
+#endif /* PERIPHERALS_MODBUS_MAP_H_ */
@@ -0,0 +1,205 @@
+/*
+ * power.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "power.h"
+#include "rtc.h"
+#include "timing.h"
+#include "events.h"
+#include "modbus.h"
+#include "i2c.h"
+#include "sampler.h"
+#include "sgp30_iaq.h"
+#include "clock.h"
+#include "adc.h"
+#include "config.h"
+
+static POWER_Stats power_stats;
+static uint32_t power_last_activity_ms = 0;
+static uint32_t power_stop_residue = 0; // Slept time below 1 ms, in 1 / RTC_TICK_HZ ms
+
+void POWER_init()
+{
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+
+	// PA10 (USART1 RX) stays in AF mode, EXTI still sees the pin p.197
+	SYSCFG->EXTICR[2] &= ~SYSCFG_EXTICR3_EXTI10;	// Port A
+	EXTI->FTSR |= EXTI_FTSR_TR10;					// Start bit is a falling edge
+	EXTI->IMR &= ~EXTI_IMR_MR10;					// Only armed while in Stop mode
+	NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+	power_last_activity_ms = TIMING_GetTick();
+}
+
+void POWER_NoteActivity()
+{
+	power_last_activity_ms = TIMING_GetTick();
+}
+
+// Milliseconds the station can spend in Stop mode, 0 when it must stay up
+static uint32_t POWER_StopBudget()
+{
+	uint32_t budget = POWER_MAX_STOP_MS;
+	uint32_t next;
+
+	if (!POWER_STOP_ENABLE || !RTC_Ready())
+	{
+		return 0;
+	}
+
+	if (MODBUS_Busy() || TIMING_GetTick() - power_last_activity_ms < POWER_RX_LINGER_MS || !I2C1_Idle() || CONFIG_SavePending())
+	{
+		return 0;
+	}
+
+	next = SAMPLER_MsUntilDue();
+	if (next < budget)
+	{
+		budget = next;
+	}
+
+	next = SGP30_IAQ_MsUntilDue();
+	if (next < budget)
+	{
+		budget = next;
+	}
+
+	return (budget < POWER_MIN_STOP_MS) ? 0 : budget;
+}
+
+static void POWER_Sleep()
+{
+	uint32_t start = TIMING_Micros();
+
+	EVENT_WaitForEvent();
+	power_stats.sleep_us += TIMING_ElapsedUs(start);
+}
+
+/*
+ * Stop mode with the low-power regulator, RM0038 p.107. Interrupts stay
+ * masked from before WFI until the clock and the timebases are restored,
+ * so no handler ever runs on MSI or sees a stale tick.
+ */
+static void POWER_Stop(uint32_t budget)
+{
+	uint32_t start, slept_ms, slept;
+	uint8_t rx_wakeup = 0;
+
+	RTC_StartWakeup(budget);
+	start = RTC_GetTicks();
+
+	__disable_irq();
+
+	if (EVENT_Pending())
+	{
+		__enable_irq();
+		RTC_StopWakeup();
+		return;
+	}
+
+	EXTI->PR = EXTI_PR_PR10;
+	EXTI->IMR |= EXTI_IMR_MR10;
+	ADC_Suspend();
+
+	PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPSDSR | PWR_CR_CWUF;
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	__DSB();
+	__WFI();
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+	CLOCK_Resume();
+	PWR->CR &= ~PWR_CR_LPSDSR;
+	ADC_Resume();
+
+	EXTI->IMR &= ~EXTI_IMR_MR10;
+	if (EXTI->PR & EXTI_PR_PR10)
+	{
+		EXTI->PR = EXTI_PR_PR10;
+		NVIC_ClearPendingIRQ(EXTI15_10_IRQn);
+		power_stats.rx_wakeups++;
+		rx_wakeup = 1;
+	}
+
+	// A 256 Hz tick is 3.9 ms, the part below 1 ms is carried to the next
+	// Stop so the clocks lose nothing over many cycles
+	RTC_Resync();
+	slept = (RTC_GetTicks() - start) * 1000 + power_stop_residue;
+	slept_ms = slept / RTC_TICK_HZ;
+	power_stop_residue = slept % RTC_TICK_HZ;
+	RTC_StopWakeup();
+	NVIC_ClearPendingIRQ(RTC_WKUP_IRQn);
+
+	TIMING_AdvanceMillis(slept_ms);
+	SGP30_IAQ_AdvanceTick(slept_ms);
+
+	power_stats.stop_ms += slept_ms;
+	power_stats.stop_count++;
+
+	// A master is talking, stay up for its retry
+	if (rx_wakeup)
+	{
+		power_last_activity_ms = TIMING_GetTick();
+	}
+
+	// Run the main loop once so the replayed ticks are handled
+	EVENT_Post(EVENT_TICK);
+	__enable_irq();
+}
+
+// Called by the main loop once all posted events are handled
+void POWER_Idle()
+{
+	uint32_t budget = POWER_StopBudget();
+
+	if (budget == 0)
+	{
+		POWER_Sleep();
+		return;
+	}
+
+	POWER_Stop(budget);
+}
+
+void POWER_GetStats(POWER_Stats *stats)
+{
+	__disable_irq();
+	*stats = power_stats;
+	__enable_irq();
+}
+
+// Share of the time since boot in one power state, in 0.1 %
+uint16_t POWER_GetResidency(POWER_State state)
+{
+	POWER_Stats stats;
+	uint64_t total = TIMING_Millis();
+	uint64_t sleep_ms, run_ms;
+
+	POWER_GetStats(&stats);
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	sleep_ms = stats.sleep_us / 1000;
+	run_ms = (total > sleep_ms + stats.stop_ms) ? total - sleep_ms - stats.stop_ms : 0;
+
+	switch (state)
+	{
+		case POWER_SLEEP:
+			return sleep_ms * 1000 / total;
+		case POWER_STOP:
+			return stats.stop_ms * 1000 / total;
+		default:
+			return run_ms * 1000 / total;
+	}
+}
+
+// Only armed in Stop mode, POWER_Stop() normally clears the line itself
+void POWER_RxWakeIRQHandler()
+{
+	EXTI->PR = EXTI_PR_PR10;
+}
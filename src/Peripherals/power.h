@@ -0,0 +1,56 @@
+/*
+ * power.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef PERIPHERALS_POWER_H_
+#define PERIPHERALS_POWER_H_
+
+#include "stm32l1xx.h"
+
+/*
+ * Power manager, replaces the plain WFI of the main loop. When nothing is
+ * pending until the next sampling or SGP30 deadline, the core goes to Stop
+ * mode with the RTC wakeup timer set to that deadline. A falling edge on
+ * USART1 RX (PA10, EXTI line 10) wakes it early. The clock of the current
+ * CLOCK_Mode is restored before any interrupt runs, and the SysTick clock
+ * (timing.h) and the SGP30 tick are advanced by the slept time. The ADC and
+ * the internal analog channels are switched off for the duration.
+ *
+ * The USART is not clocked in Stop mode, so the start bit that wakes the
+ * core is lost with the first byte. The broken frame is discarded by the
+ * t1.5/t3.5 framing and gets no reply, the master has to resend it after
+ * its response timeout (REQUEST_RETRIES in Master/sensors.py). The station
+ * stays awake for POWER_RX_LINGER_MS after bus traffic, so the resent frame
+ * and the following polls are answered at full speed. The clock is back in ~0.2 ms even on the PLL,
+ * well inside the first character (1.1 ms at 9600 baud).
+ */
+#define POWER_STOP_ENABLE 1
+#define POWER_MIN_STOP_MS 5 // Shorter idle gaps are spent in Sleep mode
+#define POWER_MAX_STOP_MS 10000
+#define POWER_RX_LINGER_MS 2000
+
+typedef enum {
+	POWER_RUN = 0,
+	POWER_SLEEP = 1,
+	POWER_STOP = 2
+} POWER_State;
+
+// Residency since boot, run time is the rest of TIMING_Millis()
+typedef struct POWER_Stats {
+	uint64_t sleep_us;
+	uint64_t stop_ms;
+	uint32_t stop_count;
+	uint32_t rx_wakeups;
+} POWER_Stats;
+
+void POWER_init();
+void POWER_Idle();
+void POWER_NoteActivity();
+void POWER_GetStats(POWER_Stats *stats);
+uint16_t POWER_GetResidency(POWER_State state);
+void POWER_RxWakeIRQHandler();
+
+#endif /* PERIPHERALS_POWER_H_ */
@@ -0,0 +1,184 @@
+/*
+ * rtc.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "rtc.h"
+
+// The calendar is only used as a seconds counter from 2000-01-01 00:00:00.
+// It lives in the backup domain, so it keeps counting through resets and,
+// with VBAT on a battery, through power cycles.
+
+static uint8_t rtc_ready = 0;
+static uint8_t rtc_was_running = 0;
+
+static const uint16_t RTC_DaysBeforeMonth[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+static void RTC_Unlock()
+{
+	RTC->WPR = 0xCA; // Write protection keys p.546
+	RTC->WPR = 0x53;
+}
+
+static void RTC_Lock()
+{
+	RTC->WPR = 0xFF;
+}
+
+static uint8_t RTC_FromBCD(uint32_t bcd)
+{
+	return ((bcd >> 4) & 0xF) * 10 + (bcd & 0xF);
+}
+
+RTC_Status RTC_init()
+{
+	RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+	PWR->CR |= PWR_CR_DBP; // Allow writes to the backup domain p.122
+
+	if ((RCC->CSR & RCC_CSR_RTCEN) && (RTC->ISR & RTC_ISR_INITS))
+	{
+		// Calendar survived the reset, wait for the shadow registers to resync
+		RTC_Unlock();
+		RTC->ISR &= ~RTC_ISR_RSF;
+		RTC_Lock();
+		while (!(RTC->ISR & RTC_ISR_RSF)){}
+
+		rtc_was_running = 1;
+		rtc_ready = 1;
+		return RTC_OK;
+	}
+
+	RCC->CSR |= RCC_CSR_LSEON;
+	for (uint32_t i = 0; !(RCC->CSR & RCC_CSR_LSERDY); ++i)
+	{
+		if (i >= RTC_LSE_TIMEOUT)
+		{
+			return RTC_NO_CLOCK;
+		}
+	}
+
+	RCC->CSR |= RCC_CSR_RTCSEL_LSE;
+	RCC->CSR |= RCC_CSR_RTCEN;
+
+	RTC_Unlock();
+	RTC->ISR |= RTC_ISR_INIT;
+	while (!(RTC->ISR & RTC_ISR_INITF)){}
+
+	RTC->PRER = (127 << 16) | 255;	// 32768 Hz / 128 / 256 = 1 Hz
+	RTC->TR = 0;
+	RTC->DR = (6 << 13) | (1 << 8) | 1;	// Saturday 2000-01-01
+
+	RTC->ISR &= ~RTC_ISR_INIT;
+	RTC_Lock();
+
+	rtc_ready = 1;
+	return RTC_OK;
+}
+
+uint8_t RTC_Ready()
+{
+	return rtc_ready;
+}
+
+// Non-zero when the calendar was already counting before this boot
+uint8_t RTC_WasRunning()
+{
+	return rtc_was_running;
+}
+
+uint32_t RTC_GetSeconds()
+{
+	if (!rtc_ready)
+	{
+		return 0;
+	}
+
+	uint32_t tr = RTC->TR; // Reading TR freezes DR until DR is read
+	uint32_t dr = RTC->DR;
+
+	uint32_t year = RTC_FromBCD(dr >> 16);
+	uint32_t month = RTC_FromBCD((dr >> 8) & 0x1F);
+	uint32_t day = RTC_FromBCD(dr & 0x3F);
+
+	uint32_t days = year * 365 + (year + 3) / 4 + RTC_DaysBeforeMonth[month - 1] + day - 1;
+	if (month > 2 && (year % 4) == 0)
+	{
+		days++;
+	}
+
+	return days * 86400 + RTC_FromBCD((tr >> 16) & 0x3F) * 3600 + RTC_FromBCD((tr >> 8) & 0x7F) * 60 + RTC_FromBCD(tr & 0x7F);
+}
+
+// Seconds in RTC_TICK_HZ units plus the subseconds, for measuring intervals.
+// Wraps, compare by difference only.
+uint32_t RTC_GetTicks()
+{
+	if (!rtc_ready)
+	{
+		return 0;
+	}
+
+	uint32_t ssr = RTC->SSR; // Reading SSR freezes TR and DR until DR is read p.559
+	uint32_t seconds = RTC_GetSeconds();
+
+	return seconds * RTC_TICK_HZ + (RTC_TICK_HZ - 1 - ssr);
+}
+
+// The shadow registers are stale after Stop mode until the next RSF p.529
+void RTC_Resync()
+{
+	RTC_Unlock();
+	RTC->ISR &= ~RTC_ISR_RSF;
+	RTC_Lock();
+	while (!(RTC->ISR & RTC_ISR_RSF)){}
+}
+
+// Wakeup timer interrupt through EXTI line 20, also wakes the core from Stop mode
+void RTC_StartWakeup(uint32_t ms)
+{
+	uint32_t ticks = ms * RTC_WAKEUP_HZ / 1000;
+
+	if (ticks == 0)
+	{
+		ticks = 1;
+	}
+
+	else if (ticks > 0x10000)
+	{
+		ticks = 0x10000;
+	}
+
+	RTC_Unlock();
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	while (!(RTC->ISR & RTC_ISR_WUTWF)){}	// WUTR writable p.530
+
+	RTC->WUTR = ticks - 1;
+	RTC->CR &= ~RTC_CR_WUCKSEL;		// RTCCLK / 16
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+	RTC_Lock();
+
+	EXTI->PR = EXTI_PR_PR20;
+	EXTI->RTSR |= EXTI_RTSR_TR20;
+	EXTI->IMR |= EXTI_IMR_MR20;
+	NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+void RTC_StopWakeup()
+{
+	RTC_Unlock();
+	RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	RTC_Lock();
+
+	EXTI->IMR &= ~EXTI_IMR_MR20;
+	EXTI->PR = EXTI_PR_PR20;
+}
+
+void RTC_WakeupIRQHandler()
+{
+	RTC->ISR &= ~RTC_ISR_WUTF;
+	EXTI->PR = EXTI_PR_PR20;
+}
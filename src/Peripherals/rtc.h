@@ -0,0 +1,33 @@
+/*
+ * rtc.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef PERIPHERALS_RTC_H_
+#define PERIPHERALS_RTC_H_
+
+#include "stm32l1xx.h"
+
+#define RTC_LSE_TIMEOUT 2000000 // Polling loops before giving up on the LSE crystal
+#define RTC_TICK_HZ 256 // Subsecond resolution, PREDIV_S + 1
+#define RTC_WAKEUP_HZ 2048 // Wakeup timer on RTCCLK / 16
+#define RTC_WAKEUP_MAX_MS 32000 // 16-bit wakeup counter
+
+typedef enum {
+	RTC_OK = 0,
+	RTC_NO_CLOCK = 1
+} RTC_Status;
+
+RTC_Status RTC_init();
+uint8_t RTC_Ready();
+uint8_t RTC_WasRunning();
+uint32_t RTC_GetSeconds();
+uint32_t RTC_GetTicks();
+void RTC_Resync();
+void RTC_StartWakeup(uint32_t ms);
+void RTC_StopWakeup();
+void RTC_WakeupIRQHandler();
+
+#endif /* PERIPHERALS_RTC_H_ */
@@ -6,12 +6,105 @@
  */
 
 #include "timers.h"
+#include "clock.h"
+
+// TIM3 one-shot times, kept to rescale them on a clock change
+static uint16_t tim3_compare_us = 0;
+static uint16_t tim3_period_us = 0;
+
+// Prescaler for a ~1 MHz counter, exact when the clock is a whole number of MHz
+uint16_t TIMERS_Prescaler(uint32_t clock_hz)
+{
+    return (clock_hz + TIMERS_COUNTER_HZ / 2) / TIMERS_COUNTER_HZ - 1;
+}
+
+static uint16_t TIMERS_UsToTicks(uint32_t clock_hz, uint16_t psc, uint16_t us)
+{
+    return (uint64_t)us * (clock_hz / (psc + 1)) / 1000000;
+}
 
 void TIM2_Init(void)
 {
     RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
-    TIM2->PSC = 32 - 1;
+    TIM2->PSC = TIMERS_Prescaler(CLOCK_GetPclk1Hz());
     TIM2->ARR = 0xFFFF;
     TIM2->CR1 |= TIM_CR1_CEN;
 }
 
+static void TIM3_Configure(void)
+{
+    uint32_t clock_hz = CLOCK_GetPclk1Hz();
+    uint16_t psc = TIMERS_Prescaler(clock_hz);
+
+    TIM3->PSC = psc;		// 1 MHz counter clock at 32 MHz
+    TIM3->ARR = TIMERS_UsToTicks(clock_hz, psc, tim3_period_us) - 1;
+    TIM3->CCR1 = TIMERS_UsToTicks(clock_hz, psc, tim3_compare_us);
+    TIM3->EGR = TIM_EGR_UG;	// Load PSC now
+    TIM3->SR = 0;
+}
+
+// One-pulse timer: CC1 fires after compare_us, update after period_us
+void TIM3_InitOneShot(uint16_t compare_us, uint16_t period_us)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+    TIM3->CR1 = TIM_CR1_OPM | TIM_CR1_URS;	// Stop at update, only overflow raises UIF
+    tim3_compare_us = compare_us;
+    tim3_period_us = period_us;
+    TIM3_Configure();
+    TIM3->DIER |= TIM_DIER_UIE | TIM_DIER_CC1IE;
+    NVIC_EnableIRQ(TIM3_IRQn);
+}
+
+void TIM3_Restart(void)
+{
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+    TIM3->CNT = 0;
+    TIM3->SR = 0;
+    TIM3->CR1 |= TIM_CR1_CEN;
+}
+
+void TIM3_Stop(void)
+{
+    TIM3->CR1 &= ~TIM_CR1_CEN;
+}
+
+// 1 ms update period. With a whole number of MHz the counter runs at 1 MHz,
+// else undivided so the period stays within one clock cycle of 1 ms.
+static void TIM6_Configure(void)
+{
+    uint32_t clock_hz = CLOCK_GetPclk1Hz();
+    uint16_t psc = (clock_hz % TIMERS_COUNTER_HZ == 0) ? clock_hz / TIMERS_COUNTER_HZ - 1 : 0;
+
+    TIM6->PSC = psc;		// 32 MHz / 32 = 1 MHz counter clock
+    TIM6->ARR = clock_hz / (psc + 1) / 1000 - 1;	// Update event every 1 ms
+}
+
+// Only paces the ADC scan, the millisecond clock is SysTick (timing.h)
+void TIM6_Init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM6EN;
+    TIM6->CR1 |= TIM_CR1_URS;	// Only overflow raises UIF, not a reload by UG
+    TIM6_Configure();
+    TIM6->EGR = TIM_EGR_UG;
+    TIM6->CR2 |= TIM_CR2_MMS_1;	// TRGO on update, triggers the ADC scan
+    TIM6->CR1 |= TIM_CR1_CEN;
+}
+
+/*
+ * Reprograms the prescalers after a PCLK1 change. TIM6 keeps its phase in
+ * the running millisecond, TIM3 must be idle (no Modbus frame in progress).
+ */
+void TIMERS_ClockChanged(void)
+{
+    uint32_t cnt = TIM6->CNT;
+    uint32_t period = TIM6->ARR + 1;
+
+    TIM2->PSC = TIMERS_Prescaler(CLOCK_GetPclk1Hz());
+    TIM2->EGR = TIM_EGR_UG;
+
+    TIM3_Configure();
+
+    TIM6_Configure();
+    TIM6->EGR = TIM_EGR_UG;
+    TIM6->CNT = cnt * (TIM6->ARR + 1) / period;
+}
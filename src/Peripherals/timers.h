@@ -10,6 +10,17 @@
 
 #include "stm32l1xx.h"
 
+#define TIMERS_COUNTER_HZ 1000000 // TIM2, TIM3 and TIM11 count microseconds
+
+uint16_t TIMERS_Prescaler(uint32_t clock_hz);
+void TIMERS_ClockChanged(void);
+
 void TIM2_Init();
 
+void TIM3_InitOneShot(uint16_t compare_us, uint16_t period_us);
+void TIM3_Restart();
+void TIM3_Stop();
+
+void TIM6_Init();
+
 #endif /* PERIPHERALS_TIMERS_H_ */
@@ -6,6 +6,9 @@
  */
 
 #include "usart.h"
+#include "clock.h"
+
+static uint16_t usart1_rx_dma_size = 0;
 
 void USART1_init(void)
 {
@@ -16,7 +19,7 @@ void USART1_init(void)
 	GPIOA->MODER|=0x00080000; 	//MODER2=PA9(TX)D8 to mode 10=alternate function mode. p184
 	GPIOA->MODER|=0x00200000; 	//MODER2=PA10(RX)D2 to mode 10=alternate function mode. p184
 
-	USART1->BRR = 0x00000D05;	//9600 BAUD and crystal 32MHz. p710, D05
+	USART1->BRR = (CLOCK_GetPclk2Hz() + MODBUS_BAUDRATE / 2) / MODBUS_BAUDRATE;	//Oversampling by 16, 0xD05 at 9600 BAUD and 32 MHz. p710
 	USART1->CR1 = 0x00000008;	//TE bit. p739-740. Enable transmit
 	USART1->CR1 |= 0x00000004;	//RE bit. p739-740. Enable receiver
 	USART1->CR1 |= 0x00002000;	//UE bit. p739-740. Uart enable
@@ -34,6 +37,55 @@ void USART1_init(void)
 	NVIC_EnableIRQ(USART1_IRQn); 	//enable interrupt in NVIC
 }
 
+// USART1_RX is served by DMA1 channel 5 in circular mode, p.257
+// Bytes land in the buffer without interrupts, the IDLE interrupt replaces RXNE.
+void USART1_EnableRxDMA(volatile uint8_t* buffer, uint16_t size)
+{
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+	usart1_rx_dma_size = size;
+
+	DMA1_Channel5->CCR = 0;
+	DMA1_Channel5->CPAR = (uint32_t)&USART1->DR;
+	DMA1_Channel5->CMAR = (uint32_t)buffer;
+	DMA1_Channel5->CNDTR = size;
+	DMA1_Channel5->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_PL_1; // Peripheral to memory, 8-bit, high priority
+	DMA1_Channel5->CCR |= DMA_CCR_EN;
+
+	USART1->CR3 |= USART_CR3_DMAR;
+	USART1->CR1 &= ~USART_CR1_RXNEIE;
+	USART1->CR1 |= USART_CR1_IDLEIE;
+}
+
+// Index in the DMA buffer where the next received byte will be written
+uint16_t USART1_RxDMAPosition()
+{
+	uint16_t position = usart1_rx_dma_size - DMA1_Channel5->CNDTR;
+	return (position == usart1_rx_dma_size) ? 0 : position;
+}
+
+// USART1_TX is served by DMA1 channel 4. The caller keeps the buffer alive
+// and watches TC to know when the last stop bit has left the shift register.
+void USART1_WriteDMA(const uint8_t* buffer, uint16_t length)
+{
+	RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+	DMA1_Channel4->CCR = 0;
+	DMA1_Channel4->CPAR = (uint32_t)&USART1->DR;
+	DMA1_Channel4->CMAR = (uint32_t)buffer;
+	DMA1_Channel4->CNDTR = length;
+	DMA1_Channel4->CCR = DMA_CCR_MINC | DMA_CCR_DIR; // Memory to peripheral, 8-bit
+
+	USART1->SR &= ~USART_SR_TC;	// TC is set after reset and after every frame, p.737
+	USART1->CR3 |= USART_CR3_DMAT;
+	DMA1_Channel4->CCR |= DMA_CCR_EN;
+}
+
+void USART1_StopTxDMA()
+{
+	DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+	DMA1->IFCR = DMA_IFCR_CGIF4;
+}
+
 char USART1_read()
 {
 	char data = 0;
@@ -69,7 +121,7 @@ void USART2_init()
 	GPIOA->MODER |= 0x00000020; 	//MODER2=PA2(TX) to mode 10=alternate function mode. p184
 	GPIOA->MODER |= 0x00000080; 	//MODER2=PA3(RX) to mode 10=alternate function mode. p184
 
-	USART2->BRR = 0x00000D05;	//9600 BAUD and crystal 32MHz. p710, 116
+	USART2->BRR = (CLOCK_GetPclk1Hz() + USART2_BAUDRATE / 2) / USART2_BAUDRATE;	//0xD05 at 9600 BAUD and 32MHz. p710, 116
 	USART2->CR1 |= USART_CR1_TE;	//TE bit. p739-740. Enable transmit
 	USART2->CR1 |= USART_CR1_RE;	//RE bit. p739-740. Enable receiver
 	USART2->CR1 |= USART_CR1_UE;	//UE bit. p739-740. Uart enable
@@ -102,3 +154,10 @@ void USART2_write_buffer(uint8_t* buffer)
 	USART2_write('\r');
 	USART2_write('\n');
 }
+
+// New baud rate divisors after a PCLK change, only while both lines are idle
+void USART_ClockChanged()
+{
+	USART1->BRR = (CLOCK_GetPclk2Hz() + MODBUS_BAUDRATE / 2) / MODBUS_BAUDRATE;
+	USART2->BRR = (CLOCK_GetPclk1Hz() + USART2_BAUDRATE / 2) / USART2_BAUDRATE;
+}
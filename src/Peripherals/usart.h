@@ -11,12 +11,19 @@
 #include "modbus.h"
 #include "stm32l1xx.h"
 
+#define USART2_BAUDRATE 9600 // Debug console
+
 void USART1_init();
+void USART1_EnableRxDMA(volatile uint8_t* buffer, uint16_t size);
+uint16_t USART1_RxDMAPosition();
+void USART1_WriteDMA(const uint8_t* buffer, uint16_t length);
+void USART1_StopTxDMA();
 void USART1_write(uint8_t data);
 char USART1_read();
 void USART1_write_buffer(uint8_t* buffer);
 
 void USART2_init();
+void USART_ClockChanged();
 void USART2_write(char data);
 char USART2_read();
 void USART2_write_buffer(uint8_t* buffer);
@@ -1,204 +1,276 @@
 #include "dht22.h"
+#include "timers.h"
+#include "events.h"
+#include "clock.h"
 
 #define DEBUG 0
 
-static volatile uint8_t pulses[BIT_COUNT];
-static volatile uint8_t dht_status = 0;
+static volatile DHT22_Phase dht_phase = DHT22_IDLE;
+static volatile uint8_t dht_status = DHT_NOT_READY;
+static volatile uint8_t dht_data[5];
+static volatile uint8_t dht_edge = 0;
+static volatile uint16_t dht_last_capture = 0;
+static volatile uint8_t dht_checksum = 0;
+static volatile DHT22_Diagnostics dht_diagnostics;
+static uint32_t dht_last_start_ms = 0;
 
-void DHT22_SWITCH_MODE_OUTPUT()
+static void DHT22_SWITCH_MODE_OUTPUT()
 {
 	GPIOA->MODER &= ~GPIO_MODER_MODER7;
 	GPIOA->MODER |= GPIO_MODER_MODER7_0;
 }
 
-void DHT22_SWITCH_MODE_INPUT()
+// Releases the line and hands it to TIM11_CH1
+static void DHT22_SWITCH_MODE_CAPTURE()
 {
 	GPIOA->MODER &= ~GPIO_MODER_MODER7;
+	GPIOA->MODER |= GPIO_MODER_MODER7_1;
+}
+
+static void DHT22_Stop(uint8_t status)
+{
+	TIM11->CR1 &= ~TIM_CR1_CEN;
+	TIM11->CCER &= ~TIM_CCER_CC1E;
+	dht_phase = DHT22_IDLE;
+	dht_status = status;
+	EVENT_Post(EVENT_SAMPLE_DONE);
 }
 
 void DHT22_init()
 {
-    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
-    SYSCFG->EXTICR[1] &= ~SYSCFG_EXTICR2_EXTI7_PA;
-    SYSCFG->EXTICR[1] |= SYSCFG_EXTICR2_EXTI7_PA;
+	RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
+	GPIOA->OTYPER |= GPIO_OTYPER_OT_7;		// Open drain, the line is only pulled low
+	GPIOA->PUPDR &= ~GPIO_PUPDR_PUPDR7;
+	GPIOA->PUPDR |= GPIO_PUPDR_PUPDR7_0;	// Pull-up next to the external one
+	GPIOA->ODR |= GPIO_ODR_ODR_7;
+	GPIOA->AFR[0] &= ~GPIO_AFRL_AFRL7;
+	GPIOA->AFR[0] |= 3 << 28;				// AF3 = TIM11_CH1, RM0038 p.177
+	DHT22_SWITCH_MODE_CAPTURE();
+
+	RCC->APB2ENR |= RCC_APB2ENR_TIM11EN;
+	TIM11->CR1 = TIM_CR1_URS;				// Only overflow raises UIF
+	TIM11->PSC = TIMERS_Prescaler(CLOCK_GetPclk2Hz());	// 1 MHz counter clock
+	TIM11->CCMR1 = TIM_CCMR1_CC1S_0			// IC1 mapped on TI1
+			| TIM_CCMR1_IC1F_0 | TIM_CCMR1_IC1F_1;	// fCK_INT, N = 8 filter
+	TIM11->CCER = TIM_CCER_CC1P;			// Falling edge
+	TIM11->EGR = TIM_EGR_UG;				// Load PSC now
+	TIM11->SR = 0;
+	TIM11->DIER = TIM_DIER_UIE | TIM_DIER_CC1IE;
+
+	NVIC_EnableIRQ(TIM11_IRQn);
+
+	// The sensor needs the same settling time after power-up
+	dht_last_start_ms = TIMING_GetTick();
+}
+
+// Pulls the line low and returns, the rest of the conversion runs in
+// DHT22_IRQHandler(). Returns DHT_ERROR if a conversion is already running
+// and DHT_NOT_READY if the last one started less than 2 s ago.
+uint8_t DHT22_Start()
+{
+	if (dht_phase != DHT22_IDLE)
+	{
+		return DHT_ERROR;
+	}
+
+	if (TIMING_GetTick() - dht_last_start_ms < DHT22_MIN_INTERVAL_MS)
+	{
+		return DHT_NOT_READY;
+	}
+
+	dht_last_start_ms = TIMING_GetTick();
+
+	dht_status = DHT_MEASURING;
+	dht_phase = DHT22_START;
+	dht_edge = 0;
+	dht_checksum = 0;
 
-    EXTI->IMR |= EXTI_IMR_MR7;
-    EXTI->FTSR |= EXTI_FTSR_FT7;
-    EXTI->RTSR |= EXTI_RTSR_RT7;
+	dht_diagnostics.error = DHT22_ERR_NONE;
+	dht_diagnostics.outlier_count = 0;
+	dht_diagnostics.response_us = 0;
+	dht_diagnostics.min_period_us = 0xFFFF;
+	dht_diagnostics.max_period_us = 0;
 
-    NVIC_EnableIRQ(EXTI9_5_IRQn);
+	for (int i = 0; i < 5; ++i)
+	{
+		dht_data[i] = 0;
+		dht_diagnostics.outlier[i] = 0;
+	}
+
+	GPIOA->ODR &= ~GPIO_ODR_ODR_7;
+	DHT22_SWITCH_MODE_OUTPUT();
+
+	TIM11->CCER &= ~TIM_CCER_CC1E;
+	TIM11->ARR = DHT22_START_US - 1;
+	TIM11->CNT = 0;
+	TIM11->SR = 0;
+	TIM11->CR1 |= TIM_CR1_CEN;
+
+	return DHT_READY;
 }
 
-uint8_t DHT22_read(MODBUS_Reading *reading)
+// Returns DHT_MEASURING while the conversion runs, then the result once.
+// The checksum has already been checked in the interrupt.
+uint8_t DHT22_GetResult(MODBUS_Reading *reading)
 {
-    uint8_t byte_list[5] = {0};
-    uint8_t buffer[100];
-
-    DHT22_start();
-
-    if (DHT22_wait_response())
-    {
-        USART2_write_buffer("DHT22 Not ready to send data!");
-        return DHT_ERROR;
-    }
-
-    SysTick->LOAD = TIMEOUT_20_MS - 1; // Set maximum allowable wait time
-	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
-
-    // Wait for data
-    while(dht_status == DHT_MEASURING)
-    {
-        if ((SysTick->CTRL) & 0x10000)
-        {
-    		USART2_write_buffer("DHT22 measurement error :/");
-            return DHT_ERROR;
-        }
-    }
-
-	SysTick->CTRL = 0;
-
-    if (dht_status == DHT_READY)
-    {
-	    EXTI->IMR &= ~EXTI_IMR_MR7;
-    	dht_status = DHT_NOT_READY;
-
-    	DHT22_decode_pulses(pulses, byte_list);
-
-		uint8_t humidity_int = byte_list[0];
-		uint8_t humidity_dec = byte_list[1];
-		uint8_t temperature_int = byte_list[2];
-		uint8_t temperature_dec = byte_list[3];
-		uint8_t checksum = byte_list[4];
-
-		uint8_t expected_checksum = humidity_int + humidity_dec + temperature_int + temperature_dec;
-		if (expected_checksum != checksum)
-		{
-			snprintf(buffer, 100, "DHT22: Invalid checksum expected %.2X got %.2X", expected_checksum, checksum);
-			USART2_write_buffer(buffer);
-		}
+	uint8_t status = dht_status;
 
-		reading->raw_reading[0] = humidity_int;
-		reading->raw_reading[1] = humidity_dec;
-		reading->raw_reading[2] = temperature_int;
-		reading->raw_reading[3] = temperature_dec;
+	if (status == DHT_MEASURING || status == DHT_NOT_READY)
+	{
+		return status;
+	}
 
-		return DHT_READY;
-    }
+	dht_status = DHT_NOT_READY;
+
+	if (status == DHT_ERROR)
+	{
+#if DEBUG
+		uint8_t buffer[100];
+		snprintf((char *)buffer, 100, "DHT22: Error %u, %u outliers", dht_diagnostics.error, dht_diagnostics.outlier_count);
+		USART2_write_buffer(buffer);
+#endif
+		return DHT_ERROR;
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		reading->raw_reading[i] = dht_data[i];
+	}
 
-    return DHT_ERROR;
+	return DHT_READY;
 }
 
-void DHT22_start()
+void DHT22_GetDiagnostics(DHT22_Diagnostics *diagnostics)
 {
-    EXTI->IMR &= ~EXTI_IMR_MR7;
-    // MCU PULL LOW ~20ms
-    DHT22_SWITCH_MODE_OUTPUT();
-    GPIOA->ODR &= ~GPIO_ODR_ODR_7;
-    delay_ms(20);
-
-    // MCU RELEASE LINE 20-40us
-    GPIOA->ODR |= GPIO_ODR_ODR_7;
-    DHT22_SWITCH_MODE_INPUT();
-	delay_us(20);
+	__disable_irq();
+	*diagnostics = *(DHT22_Diagnostics *)&dht_diagnostics;
+	__enable_irq();
 }
 
-uint8_t DHT22_wait_response()
+// Relative humidity in 0.1 %
+uint16_t DHT22_Humidity(const MODBUS_Reading *reading)
 {
-    SysTick->LOAD = TIMEOUT_90_US - 1; // Set maximum allowable wait time
-	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
-
-    while (!(GPIOA->IDR & GPIO_IDR_IDR_7))
-    {
-        if ((SysTick->CTRL) & 0x10000)
-        {
-    		USART2_write_buffer("Timeout error when waiting for DHT22 response PULL LOW");
-            return DHT_ERROR;
-        }
-    }
-
-    EXTI->IMR |= EXTI_IMR_MR7;
-
-    SysTick->LOAD = TIMEOUT_90_US - 1; // Set maximum allowable wait time 85µs
-	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
-    while (GPIOA->IDR & GPIO_IDR_IDR_7)
-    {
-        if ((SysTick->CTRL) & 0x10000)
-        {
-    		USART2_write_buffer("Timeout error when waiting for DHT22 response GET READY");
-            return DHT_ERROR;
-        }
-    }
-
-    SysTick->CTRL = 0;
-
-    return 0;
+	return (reading->raw_reading[0] << 8) | reading->raw_reading[1];
 }
 
-void DHT22_decode_pulses(volatile uint8_t *pulses, uint8_t *byte_list)
+// DHT22 sends temperature as sign + 15-bit magnitude in 0.1 C
+int16_t DHT22_Temperature(const MODBUS_Reading *reading)
 {
-    uint8_t current_byte = 0;
-
-    for (int bit = 1; bit <= BIT_COUNT; bit++)
-    {
-        if (pulses[bit] > 20 && pulses[bit] < 32)
-        {
-            current_byte = (current_byte << 1) | 0;
-        }
-        else
-        {
-            current_byte = (current_byte << 1) | 1;
-        }
-
-        if ((bit % 8) == 0)
-        {
-            byte_list[(bit / 8) - 1] = current_byte;
-            current_byte = 0;
-        }
-    }
+	uint16_t word = (reading->raw_reading[2] << 8) | reading->raw_reading[3];
+	int16_t value = word & 0x7FFF;
+
+	return (word & 0x8000) ? -value : value;
 }
 
-void DHT22_ModbusHandler(MODBUS_Reading* reading)
+static void DHT22_Fail(uint8_t error)
 {
-	DHT22_read(reading);
+	dht_diagnostics.error = error;
+	DHT22_Stop(DHT_ERROR);
 }
 
-void DHT22_IRQHandler()
+// Decodes one data bit from its falling-to-falling period. Bytes and the
+// checksum are built as the bits arrive, so the result is final on the
+// last edge.
+static void DHT22_DecodeBit(uint8_t bit, uint16_t period)
 {
-	static uint8_t index = 0;
-	static uint16_t last_time = 0;
-	uint16_t now = TIM2->CNT;
-	uint16_t pulse_width;
+	uint8_t index = bit >> 3;
+	uint8_t value = period > DHT22_BIT_THRESHOLD_US;
 
-	dht_status = DHT_MEASURING;
+	dht_data[index] = (dht_data[index] << 1) | value;
+
+	if (period < dht_diagnostics.min_period_us)
+	{
+		dht_diagnostics.min_period_us = period;
+	}
 
-	if (GPIOA->IDR & GPIO_IDR_IDR_7) // Rising edge
+	if (period > dht_diagnostics.max_period_us)
 	{
-		last_time = now;
-		GPIOA->ODR |= GPIO_ODR_ODR_5;
+		dht_diagnostics.max_period_us = period;
 	}
 
-	else // Falling edge
+	if (value ? (period < DHT22_BIT1_MIN_US || period > DHT22_BIT1_MAX_US)
+			: (period < DHT22_BIT0_MIN_US || period > DHT22_BIT0_MAX_US))
 	{
-		pulse_width = (now >= last_time) ? (now - last_time) : (0xFFFF - last_time + now);
-		pulses[index] = pulse_width;
-		index++;
-		GPIOA->ODR &= ~GPIO_ODR_ODR_5;
+		dht_diagnostics.outlier[index] |= 0x80 >> (bit & 7);
+		dht_diagnostics.outlier_count++;
 	}
 
-	if (index >= BIT_COUNT)
+	if ((bit & 7) != 7)
 	{
-		index = 0;
-		dht_status = DHT_READY;
+		return;
 	}
 
-	EXTI->PR = EXTI_PR_PR7;
+	if (index < 4)
+	{
+		dht_checksum += dht_data[index];
+		return;
+	}
+
+	if (dht_data[4] != dht_checksum)
+	{
+		DHT22_Fail(DHT22_ERR_CHECKSUM);
+		return;
+	}
+
+	DHT22_Stop(DHT_READY);
 }
 
+// TIM11 prescaler for the new PCLK2, conversions only run where it gives exactly 1 MHz
+void DHT22_ClockChanged()
+{
+	TIM11->PSC = TIMERS_Prescaler(CLOCK_GetPclk2Hz());
+	TIM11->EGR = TIM_EGR_UG;
+	TIM11->SR = 0;
+}
 
+// TIM11 interrupt: update ends the start pulse or times the answer out,
+// CC1 timestamps a falling edge and decodes one bit.
+void DHT22_IRQHandler()
+{
+	if (TIM11->SR & TIM_SR_CC1IF)
+	{
+		uint16_t capture = TIM11->CCR1; // Clears CC1IF
+		uint16_t period = capture - dht_last_capture; // 16-bit wrap-safe
+		dht_last_capture = capture;
 
+		if (dht_phase == DHT22_CAPTURE)
+		{
+			dht_edge++;
+
+			if (dht_edge == DHT22_RESPONSE_EDGES)
+			{
+				dht_diagnostics.response_us = period;
+
+				if (period < DHT22_RESPONSE_MIN_US || period > DHT22_RESPONSE_MAX_US)
+				{
+					DHT22_Fail(DHT22_ERR_RESPONSE);
+				}
+			}
+
+			else if (dht_edge > DHT22_RESPONSE_EDGES)
+			{
+				DHT22_DecodeBit(dht_edge - DHT22_RESPONSE_EDGES - 1, period);
+			}
+		}
+	}
 
+	if (TIM11->SR & TIM_SR_UIF)
+	{
+		TIM11->SR &= ~TIM_SR_UIF;
 
+		if (dht_phase == DHT22_START)
+		{
+			// Release the line, the sensor answers within 20-40 us
+			DHT22_SWITCH_MODE_CAPTURE();
+			TIM11->ARR = DHT22_TIMEOUT_US - 1;
+			TIM11->SR = 0;
+			TIM11->CCER |= TIM_CCER_CC1E;
+			dht_phase = DHT22_CAPTURE;
+		}
 
+		else if (dht_phase == DHT22_CAPTURE)
+		{
+			DHT22_Fail(DHT22_ERR_TIMEOUT);
+		}
+	}
+}
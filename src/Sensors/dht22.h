@@ -14,28 +14,67 @@
 #include "usart.h"
 #include <stdio.h>
 
-#define TIMEOUT_20_MS 640000
-#define TIMEOUT_90_US 2880
-#define TIMEOUT_50_US 1600
-#define TIMEOUT_28_US 896
+/*
+ * DHT22 on PA7 = TIM11_CH1 (AF3). TIM11 counts at 1 MHz and times the start
+ * pulse with its update event, then captures the falling edges of the answer.
+ * The time between two falling edges is 50 us low + 26-28 us (0) or 70 us (1) high.
+ */
+#define DHT22_MIN_INTERVAL_MS 2000 // Datasheet minimum between conversions, also after power-up
+#define DHT22_START_US 20000 // Host start pulse, datasheet minimum 1 ms
+#define DHT22_TIMEOUT_US 10000 // Whole answer takes ~5 ms
+#define DHT22_BIT_THRESHOLD_US 100 // Falling-to-falling period, 0 ~ 78 us, 1 ~ 120 us
+#define DHT22_RESPONSE_EDGES 2 // Response low start and first data bit start
+#define DHT22_DATA_BITS 40
+
+// Periods outside these windows are flagged as outliers in DHT22_Diagnostics
+#define DHT22_RESPONSE_MIN_US 140 // 80 us low + 80 us high
+#define DHT22_RESPONSE_MAX_US 190
+#define DHT22_BIT0_MIN_US 65
+#define DHT22_BIT0_MAX_US 95
+#define DHT22_BIT1_MIN_US 105
+#define DHT22_BIT1_MAX_US 140
 
 #define DHT_MEASURING 3
 #define DHT_NOT_READY 2
 #define DHT_ERROR 1
 #define DHT_READY 0
 
-#define BIT_COUNT 41
 #define DHT22_MODBUS_ADDRESS 0x6
 
-uint8_t DHT22_read_byte();
-uint8_t DHT22_read_bit();
-uint8_t DHT22_wait_response();
-uint8_t DHT22_read(MODBUS_Reading* reading);
-uint8_t DHT22_read_response(uint8_t *data);
+typedef enum {
+	DHT22_IDLE = 0,
+	DHT22_START = 1,
+	DHT22_CAPTURE = 2
+} DHT22_Phase;
+
+typedef enum {
+	DHT22_ERR_NONE = 0,
+	DHT22_ERR_TIMEOUT = 1, // Fewer than 42 falling edges before DHT22_TIMEOUT_US
+	DHT22_ERR_RESPONSE = 2, // Response period out of range
+	DHT22_ERR_CHECKSUM = 3
+} DHT22_Error;
+
+/*
+ * Timing of the last conversion. outlier[] is laid out like the five data
+ * bytes, a set bit marks a data bit whose period was outside both windows
+ * and was decoded by DHT22_BIT_THRESHOLD_US alone.
+ */
+typedef struct DHT22_Diagnostics {
+	uint8_t error;
+	uint8_t outlier_count;
+	uint8_t outlier[5];
+	uint16_t response_us;
+	uint16_t min_period_us;
+	uint16_t max_period_us;
+} DHT22_Diagnostics;
+
 void DHT22_init();
-void DHT22_start();
+uint8_t DHT22_Start();
+uint8_t DHT22_GetResult(MODBUS_Reading *reading);
+void DHT22_GetDiagnostics(DHT22_Diagnostics *diagnostics);
 void DHT22_IRQHandler();
-void DHT22_decode_pulses(volatile uint8_t *pulses, uint8_t *byte_list);
-void DHT22_ModbusHandler(MODBUS_Reading* reading);
+void DHT22_ClockChanged();
+uint16_t DHT22_Humidity(const MODBUS_Reading *reading);
+int16_t DHT22_Temperature(const MODBUS_Reading *reading);
 
 #endif /* SENSORS_DHT22_H_ */
@@ -8,6 +8,7 @@
 
 #include "lmt84lp.h"
 #include "adc.h"
+#include "convert.h"
 #include <stdio.h>
 #include "usart.h"
 
@@ -16,28 +17,26 @@
 
 #define LMT84LP_MODBUS_ADDRESS 0x1
 
-#define T_MAX 150.0f
-#define T_MIN -50.0f
-#define U_MIN 1.299f
-#define U_MAX 0.183f
-
 void LMT84LP_init()
 {
 	RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
 	GPIOA->MODER |= GPIO_MODER_MODER0;
 }
 
-void LMT84LP_read(MODBUS_Reading *reading)
+// Latest value of the background ADC scan, temperature in 0.01 C.
+// Returns 1 until the first oversampled value is ready.
+uint8_t LMT84LP_read(MODBUS_Reading *reading)
 {
-	ADC1->SQR5 &= ~CHANNEL_MASK;
-	ADC1->SQR5 |= 0;
-	ADC1->CR2 |= ADC_CR2_ADON;
-	ADC1->CR2 |= ADC_CR2_SWSTART;
+	if (!ADC_OversampledReady(ADC_SCAN_LMT84LP))
+	{
+		return 1;
+	}
 
-	while(!(ADC1->SR & ADC_SR_EOC)){}
-	reading->raw_reading[0] = ADC1->DR;
+	reading->raw_reading[0] = ADC_GetSample(ADC_SCAN_LMT84LP);
+	reading->raw_reading[1] = ADC_GetOversampled(ADC_SCAN_LMT84LP);
+	reading->temperature = (uint16_t)CONVERT_LMT84Temperature(CONVERT_AdcToVoltage(reading->raw_reading[1], ADC_GetVdda()));
 
-	ADC1->CR2 &= ~ADC_CR2_ADON;
+	return 0;
 }
 
 void LMT84LP_ModbusHander(MODBUS_Reading *reading)
@@ -14,7 +14,7 @@
 #define LMT84LP_MODBUS_ADDRESS 0x01
 
 void LMT84LP_init();
-void LMT84LP_read(MODBUS_Reading *reading);
+uint8_t LMT84LP_read(MODBUS_Reading *reading);
 void LMT84LP_ModbusHander(MODBUS_Reading *reading);
 
 #endif /* SENSORS_LMT84LP_H_ */
@@ -8,7 +8,7 @@
 
 #include "nsl19m51.h"
 #include "adc.h"
-#include <math.h>
+#include "convert.h"
 
 // PIN PA1
 
@@ -18,17 +18,20 @@ void NSL19M51_init()
 	GPIOA->MODER |= GPIO_MODER_MODER1;
 }
 
-void NSL19M51_read(MODBUS_Reading *reading)
+// Latest value of the background ADC scan, illuminance in 0.1 lux.
+// Returns 1 until the first oversampled value is ready.
+uint8_t NSL19M51_read(MODBUS_Reading *reading)
 {
-	ADC1->SQR5 &= ~CHANNEL_MASK;
-	ADC1->SQR5 |= 1;
-	ADC1->CR2 |= ADC_CR2_ADON;
-	ADC1->CR2 |= ADC_CR2_SWSTART;
+	if (!ADC_OversampledReady(ADC_SCAN_NSL19M51))
+	{
+		return 1;
+	}
 
-	while(!(ADC1->SR & ADC_SR_EOC)){}
-	reading->raw_reading[0] = ADC1->DR;
+	reading->raw_reading[0] = ADC_GetSample(ADC_SCAN_NSL19M51);
+	reading->raw_reading[1] = ADC_GetOversampled(ADC_SCAN_NSL19M51);
+	reading->lux = CONVERT_NSL19M51Lux(CONVERT_AdcToVoltage(reading->raw_reading[1], ADC_GetVdda()));
 
-	ADC1->CR2 &= ~ADC_CR2_ADON;
+	return 0;
 }
 
 void NSL19M51_ModbusHandler(MODBUS_Reading *reading)
@@ -15,7 +15,7 @@
 #define NSL19M51_MODBUS_ADDRESS 0x4
 
 void NSL19M51_init();
-void NSL19M51_read(MODBUS_Reading *reading);
+uint8_t NSL19M51_read(MODBUS_Reading *reading);
 void NSL19M51_ModbusHandler(MODBUS_Reading *reading);
 
 #endif /* SENSORS_NSL19M51_H_ */
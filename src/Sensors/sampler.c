@@ -0,0 +1,291 @@
+/*
+ * sampler.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "sampler.h"
+#include "timing.h"
+#include "lmt84lp.h"
+#include "nsl19m51.h"
+#include "dht22.h"
+#include "sgp30_iaq.h"
+
+static uint8_t SAMPLER_AcquireLMT84LP(MODBUS_Reading *reading);
+static uint8_t SAMPLER_AcquireNSL19M51(MODBUS_Reading *reading);
+static uint8_t SAMPLER_AcquireSGP30(MODBUS_Reading *reading);
+static uint8_t SAMPLER_AcquireDHT22(MODBUS_Reading *reading);
+static uint8_t SAMPLER_StartDHT22();
+
+static SAMPLER_Slot SAMPLER_Table[SAMPLER_SENSOR_COUNT] = {
+	[CONFIG_SENSOR_LMT84LP]  = { .acquire = SAMPLER_AcquireLMT84LP },
+	[CONFIG_SENSOR_NSL19M51] = { .acquire = SAMPLER_AcquireNSL19M51 },
+	[CONFIG_SENSOR_SGP30]    = { .acquire = SAMPLER_AcquireSGP30 },
+	[CONFIG_SENSOR_DHT22]    = { .acquire = SAMPLER_AcquireDHT22, .start = SAMPLER_StartDHT22 },
+};
+
+static uint8_t SAMPLER_AcquireLMT84LP(MODBUS_Reading *reading)
+{
+	uint8_t result = LMT84LP_read(reading);
+
+	reading->value[0] = (int16_t)reading->temperature;
+	return result;
+}
+
+static uint8_t SAMPLER_AcquireNSL19M51(MODBUS_Reading *reading)
+{
+	uint8_t result = NSL19M51_read(reading);
+
+	reading->value[0] = reading->lux;
+	return result;
+}
+
+static uint8_t SAMPLER_AcquireSGP30(MODBUS_Reading *reading)
+{
+	uint8_t result = SGP30_IAQ_GetReading(reading);
+
+	reading->value[0] = reading->co2_eq_ppm;
+	reading->value[1] = reading->tvoc_ppb;
+	return result;
+}
+
+static uint8_t SAMPLER_StartDHT22()
+{
+	switch (DHT22_Start())
+	{
+		case DHT_READY:
+			return SAMPLER_ACQUIRE_OK;
+		case DHT_NOT_READY:
+			return SAMPLER_ACQUIRE_PENDING; // Inside the 2 s minimum interval
+		default:
+			return SAMPLER_ACQUIRE_FAILED;
+	}
+}
+
+static uint8_t SAMPLER_AcquireDHT22(MODBUS_Reading *reading)
+{
+	switch (DHT22_GetResult(reading))
+	{
+		case DHT_MEASURING:
+			return SAMPLER_ACQUIRE_PENDING;
+		case DHT_READY:
+			reading->value[0] = DHT22_Humidity(reading);
+			reading->value[1] = DHT22_Temperature(reading);
+			return SAMPLER_ACQUIRE_OK;
+		default:
+			return SAMPLER_ACQUIRE_FAILED;
+	}
+}
+
+static SAMPLER_Slot* SAMPLER_FindSlot(uint8_t sensor)
+{
+	if (sensor >= SAMPLER_SENSOR_COUNT)
+	{
+		return NULL;
+	}
+
+	return &SAMPLER_Table[sensor];
+}
+
+void SAMPLER_init()
+{
+	// Intervals are 16-bit, so this makes every sensor due on the first pass
+	uint32_t due = TIMING_GetTick() - UINT16_MAX;
+
+	for (int i = 0; i < SAMPLER_SENSOR_COUNT; ++i)
+	{
+		SAMPLER_Table[i].front = 0;
+		SAMPLER_Table[i].valid = 0;
+		SAMPLER_Table[i].error_count = 0;
+		SAMPLER_Table[i].last_failed = 0;
+		SAMPLER_Table[i].pending = 0;
+
+		for (int j = 0; j < 2; ++j)
+		{
+			FILTER_Reset(&SAMPLER_Table[i].filter[j], &(FILTER_Config){ 0 });
+		}
+		SAMPLER_Table[i].last_sample_ms = due;
+	}
+}
+
+static void SAMPLER_Filter(SAMPLER_Slot *slot, const CONFIG_Sensor *config, MODBUS_Reading *reading)
+{
+	FILTER_Config filter = {
+		.median = config->median_length,
+		.ema_shift = config->filter_shift,
+		.boxcar = config->boxcar_length,
+	};
+
+	for (int i = 0; i < 2; ++i)
+	{
+		reading->value[i] = FILTER_Apply(&slot->filter[i], &filter, reading->value[i]);
+	}
+}
+
+static void SAMPLER_Complete(SAMPLER_Slot *slot, const CONFIG_Sensor *config, uint8_t result)
+{
+	uint8_t back = !slot->front;
+
+	if (result != SAMPLER_ACQUIRE_OK)
+	{
+		slot->error_count++;
+		slot->last_failed = 1;
+		return;
+	}
+
+	slot->last_failed = 0;
+	SAMPLER_Filter(slot, config, &slot->buffer[back]);
+
+	slot->timestamp[back] = TIMING_GetTick();
+	slot->front = back;
+	slot->valid = 1;
+}
+
+// Acquires at most one due sensor per call so a Modbus frame never waits
+// behind a whole round of conversions. Split-phase conversions only cost a
+// poll while they run.
+void SAMPLER_Process()
+{
+	const STATION_Config *config = CONFIG_Get();
+	uint32_t now = TIMING_GetTick();
+
+	for (int i = 0; i < SAMPLER_SENSOR_COUNT; ++i)
+	{
+		SAMPLER_Slot *slot = &SAMPLER_Table[i];
+		uint8_t back = !slot->front;
+
+		if (slot->pending)
+		{
+			uint8_t result = slot->acquire(&slot->buffer[back]);
+
+			if (result != SAMPLER_ACQUIRE_PENDING)
+			{
+				slot->pending = 0;
+				SAMPLER_Complete(slot, &config->sensor[i], result);
+			}
+			continue;
+		}
+
+		if (!CONFIG_SensorEnabled(i))
+		{
+			continue;
+		}
+
+		if (now - slot->last_sample_ms < config->sensor[i].interval_ms)
+		{
+			continue;
+		}
+
+		if (slot->start != NULL)
+		{
+			uint8_t result = slot->start();
+
+			// The sensor asked to wait, stay due and try again next pass
+			if (result == SAMPLER_ACQUIRE_PENDING)
+			{
+				continue;
+			}
+
+			slot->last_sample_ms = now;
+
+			if (result != SAMPLER_ACQUIRE_OK)
+			{
+				SAMPLER_Complete(slot, &config->sensor[i], SAMPLER_ACQUIRE_FAILED);
+				return;
+			}
+
+			slot->pending = 1;
+			return;
+		}
+
+		slot->last_sample_ms = now;
+
+		SAMPLER_Complete(slot, &config->sensor[i], slot->acquire(&slot->buffer[back]));
+		return;
+	}
+}
+
+// Time until the next enabled sensor is due, 0 while a conversion runs
+uint32_t SAMPLER_MsUntilDue()
+{
+	const STATION_Config *config = CONFIG_Get();
+	uint32_t now = TIMING_GetTick();
+	uint32_t next = UINT32_MAX;
+
+	for (int i = 0; i < SAMPLER_SENSOR_COUNT; ++i)
+	{
+		SAMPLER_Slot *slot = &SAMPLER_Table[i];
+		uint32_t elapsed = now - slot->last_sample_ms;
+
+		if (slot->pending)
+		{
+			return 0;
+		}
+
+		if (!CONFIG_SensorEnabled(i))
+		{
+			continue;
+		}
+
+		if (elapsed >= config->sensor[i].interval_ms)
+		{
+			return 0;
+		}
+
+		if (config->sensor[i].interval_ms - elapsed < next)
+		{
+			next = config->sensor[i].interval_ms - elapsed;
+		}
+	}
+
+	return next;
+}
+
+SAMPLER_Status SAMPLER_GetReading(uint8_t sensor, MODBUS_Reading *reading, uint16_t *age_ms)
+{
+	SAMPLER_Slot *slot = SAMPLER_FindSlot(sensor);
+
+	if (slot == NULL)
+	{
+		return SAMPLER_UNKNOWN_SENSOR;
+	}
+
+	if (!slot->valid)
+	{
+		return SAMPLER_NO_DATA;
+	}
+
+	uint8_t front = slot->front;
+	uint32_t age = TIMING_GetTick() - slot->timestamp[front];
+
+	*reading = slot->buffer[front];
+	*age_ms = (age > SAMPLER_AGE_MAX) ? SAMPLER_AGE_MAX : (uint16_t)age;
+
+	return SAMPLER_OK;
+}
+
+uint16_t SAMPLER_GetStatusWord(uint8_t sensor)
+{
+	SAMPLER_Slot *slot = SAMPLER_FindSlot(sensor);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+
+	uint16_t errors = (slot->error_count > 0xFF) ? 0xFF : slot->error_count;
+	uint16_t status = errors << SAMPLER_STATUS_ERRORS_SHIFT;
+
+	if (slot->valid)
+	{
+		status |= SAMPLER_STATUS_VALID;
+	}
+
+	if (slot->last_failed)
+	{
+		status |= SAMPLER_STATUS_LAST_FAILED;
+	}
+
+	return status;
+}
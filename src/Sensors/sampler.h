@@ -0,0 +1,75 @@
+/*
+ * sampler.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef SENSORS_SAMPLER_H_
+#define SENSORS_SAMPLER_H_
+
+#include "stm32l1xx.h"
+#include "modbus.h"
+
+#include "config.h"
+#include "filter.h"
+
+#define SAMPLER_SENSOR_COUNT CONFIG_SENSOR_COUNT
+#define SAMPLER_AGE_MAX 0xFFFF
+
+typedef enum {
+	SAMPLER_OK = 0,
+	SAMPLER_NO_DATA = 1,
+	SAMPLER_UNKNOWN_SENSOR = 2
+} SAMPLER_Status;
+
+// Status word published in the register map
+#define SAMPLER_STATUS_VALID 0x0001 // At least one reading has been cached
+#define SAMPLER_STATUS_LAST_FAILED 0x0002 // Latest acquisition failed, reading is from an earlier one
+#define SAMPLER_STATUS_ERRORS_SHIFT 8 // Bits 15:8 hold the saturated error count
+
+// Acquire results
+#define SAMPLER_ACQUIRE_OK 0
+#define SAMPLER_ACQUIRE_FAILED 1
+#define SAMPLER_ACQUIRE_PENDING 2 // Split-phase conversion still running
+
+typedef uint8_t (*SAMPLER_AcquireFunc)(MODBUS_Reading *reading);
+typedef uint8_t (*SAMPLER_StartFunc)();
+
+/*
+ * One sensor in the sampling table, indexed by CONFIG_SENSOR_*. The reading is double-buffered: the
+ * acquisition always fills buffer[!front] and only flips front once the new
+ * reading is complete, so a reader never sees a half-written reading.
+ * Interval and enable bit come from the station config (CONFIG_Get()).
+ *
+ * Sensors with a start function are split-phase: start() kicks off the
+ * conversion when the slot is due and acquire() is polled until it stops
+ * returning SAMPLER_ACQUIRE_PENDING. A start() returning
+ * SAMPLER_ACQUIRE_PENDING leaves the slot due for the next pass.
+ *
+ * acquire() also fills the reading's engineering values, which run through
+ * the sensor's filter pipeline before the reading is published.
+ */
+typedef struct SAMPLER_Slot {
+	SAMPLER_AcquireFunc acquire;
+	SAMPLER_StartFunc start;
+
+	MODBUS_Reading buffer[2];
+	uint32_t timestamp[2];
+	volatile uint8_t front;
+	volatile uint8_t valid;
+	uint32_t last_sample_ms;
+	uint16_t error_count;
+	uint8_t last_failed;
+	uint8_t pending;
+
+	FILTER_State filter[2]; // One pipeline per engineering value
+} SAMPLER_Slot;
+
+void SAMPLER_init();
+void SAMPLER_Process();
+uint32_t SAMPLER_MsUntilDue();
+SAMPLER_Status SAMPLER_GetReading(uint8_t sensor, MODBUS_Reading *reading, uint16_t *age_ms);
+uint16_t SAMPLER_GetStatusWord(uint8_t sensor);
+
+#endif /* SENSORS_SAMPLER_H_ */
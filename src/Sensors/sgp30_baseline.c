@@ -0,0 +1,117 @@
+/*
+ * sgp30_baseline.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "sgp30_baseline.h"
+#include "sgp30.h"
+#include "sgp30_iaq.h"
+#include "eeprom.h"
+#include "rtc.h"
+#include "timer_wheel.h"
+#include "modbus.h"
+#include "usart.h"
+#include <stddef.h>
+
+#define DEBUG 0
+
+// Endurance: one record rewritten hourly is ~9000 cycles a year against
+// 300k cycles per data EEPROM word, and unchanged words are not rewritten.
+
+static TWHEEL_Id baseline_timer = TWHEEL_INVALID;
+static volatile uint8_t baseline_save_due = 0;
+static uint32_t baseline_wait_ms = SGP30_BASELINE_FIRST_SAVE_MS;
+
+static uint16_t SGP30_BASELINE_RecordCRC(SGP30_BaselineRecord *record)
+{
+	return CRC16((uint8_t *)record, offsetof(SGP30_BaselineRecord, crc));
+}
+
+static void SGP30_BASELINE_Due(void *arg)
+{
+	(void)arg;
+	baseline_save_due = 1;
+}
+
+// Call right after sgp30_iaq_init() and TWHEEL_Init()
+SGP30_BaselineStatus SGP30_BASELINE_init()
+{
+	SGP30_BaselineRecord record;
+
+	baseline_timer = TWHEEL_Create(SGP30_BASELINE_Due, NULL);
+	TWHEEL_Start(baseline_timer, baseline_wait_ms, 0);
+
+	EEPROM_Read(SGP30_BASELINE_EEPROM_OFFSET, &record, sizeof(record));
+
+	if (record.magic != SGP30_BASELINE_MAGIC || record.crc != SGP30_BASELINE_RecordCRC(&record))
+	{
+		return SGP30_BASELINE_NONE;
+	}
+
+	if (RTC_WasRunning() && record.saved_at_s != 0)
+	{
+		uint32_t now = RTC_GetSeconds();
+
+		if (now < record.saved_at_s || now - record.saved_at_s > SGP30_BASELINE_MAX_AGE_S)
+		{
+#if DEBUG > 0
+			USART2_write_buffer((uint8_t *)"SGP30: Stored baseline too old, relearning");
+#endif
+			return SGP30_BASELINE_TOO_OLD;
+		}
+	}
+
+	else if (!SGP30_BASELINE_RESTORE_UNKNOWN_AGE)
+	{
+		return SGP30_BASELINE_TOO_OLD;
+	}
+
+	if (sgp30_set_iaq_baseline(record.baseline) != STATUS_OK)
+	{
+		return SGP30_BASELINE_ERROR;
+	}
+
+#if DEBUG > 0
+	USART2_write_buffer((uint8_t *)"SGP30: Baseline restored");
+#endif
+
+	// A restored baseline is already valid, keep it fresh from the first hour
+	baseline_wait_ms = SGP30_BASELINE_SAVE_INTERVAL_MS;
+	TWHEEL_Start(baseline_timer, baseline_wait_ms, 0);
+	return SGP30_BASELINE_RESTORED;
+}
+
+// Stores the chip's baseline once it is trustworthy and then every hour
+void SGP30_BASELINE_Process()
+{
+	SGP30_BaselineRecord record;
+	uint32_t baseline;
+
+	// Due from the timer, waits here until the SGP30 is between measurements
+	if (!baseline_save_due || !SGP30_IAQ_Idle())
+	{
+		return;
+	}
+
+	baseline_save_due = 0;
+	TWHEEL_Start(baseline_timer, baseline_wait_ms, 0);
+
+	if (sgp30_get_iaq_baseline(&baseline) != STATUS_OK)
+	{
+		return;
+	}
+
+	record.magic = SGP30_BASELINE_MAGIC;
+	record.baseline = baseline;
+	record.saved_at_s = RTC_Ready() ? RTC_GetSeconds() : 0;
+	record.crc = SGP30_BASELINE_RecordCRC(&record);
+
+	if (EEPROM_Write(SGP30_BASELINE_EEPROM_OFFSET, &record, sizeof(record)) == EEPROM_OK
+			&& baseline_wait_ms != SGP30_BASELINE_SAVE_INTERVAL_MS)
+	{
+		baseline_wait_ms = SGP30_BASELINE_SAVE_INTERVAL_MS;
+		TWHEEL_Start(baseline_timer, baseline_wait_ms, 0);
+	}
+}
@@ -0,0 +1,40 @@
+/*
+ * sgp30_baseline.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef SENSORS_SGP30_BASELINE_H_
+#define SENSORS_SGP30_BASELINE_H_
+
+#include "stm32l1xx.h"
+
+#define SGP30_BASELINE_EEPROM_OFFSET 0x0400 // After the config slots
+#define SGP30_BASELINE_MAGIC 0x53475042 // "SGPB"
+
+#define SGP30_BASELINE_FIRST_SAVE_MS (12UL * 3600UL * 1000UL) // Learning time without a restored baseline
+#define SGP30_BASELINE_SAVE_INTERVAL_MS (3600UL * 1000UL)
+#define SGP30_BASELINE_MAX_AGE_S (7UL * 24UL * 3600UL) // Sensirion: do not restore after a week
+
+// Restore a baseline whose age cannot be checked because the RTC lost power
+#define SGP30_BASELINE_RESTORE_UNKNOWN_AGE 1
+
+typedef struct SGP30_BaselineRecord {
+	uint32_t magic;
+	uint32_t baseline;
+	uint32_t saved_at_s; // RTC seconds, 0 when the RTC is not running
+	uint32_t crc;
+} SGP30_BaselineRecord;
+
+typedef enum {
+	SGP30_BASELINE_RESTORED = 0,
+	SGP30_BASELINE_NONE = 1,
+	SGP30_BASELINE_TOO_OLD = 2,
+	SGP30_BASELINE_ERROR = 3
+} SGP30_BaselineStatus;
+
+SGP30_BaselineStatus SGP30_BASELINE_init();
+void SGP30_BASELINE_Process();
+
+#endif /* SENSORS_SGP30_BASELINE_H_ */
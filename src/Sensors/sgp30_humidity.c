@@ -0,0 +1,121 @@
+/*
+ * sgp30_humidity.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "sgp30_humidity.h"
+#include "sgp30.h"
+#include "sgp30_iaq.h"
+#include "sampler.h"
+#include "dht22.h"
+#include "timing.h"
+
+/*
+ * Saturation vapour density in mg/m^3 from -40 C to 80 C in 5 C steps,
+ * 216.7 * 6.112 * exp(17.62 * T / (243.12 + T)) / (273.15 + T) * 1000
+ * (Sensirion SGP30 driver integration guide, Magnus formula).
+ */
+static const uint32_t SGP30_HUMIDITY_Saturation[SGP30_HUMIDITY_TABLE_SIZE] = {
+	177, 287, 456, 708, 1078, 1611, 2364, 3412, 4849, 6792, 9383, 12797,
+	17243, 22968, 30264, 39471, 50983, 65250, 82785, 104168, 130048, 161150,
+	198277, 242312, 294224
+};
+
+static uint16_t humidity_last_rh = 0xFFFF;
+static int16_t humidity_last_temperature = 0;
+static uint32_t humidity_pushed_mg = 0;
+static uint32_t humidity_pending_mg = 0;
+static uint8_t humidity_pending = 0;
+static uint32_t humidity_retry_tick = 0;
+static uint32_t humidity_failures = 0;
+
+// Absolute humidity in mg/m^3 from temperature in 0.1 C and RH in 0.1 %
+uint32_t SGP30_HUMIDITY_Absolute(int16_t temperature_dc, uint16_t humidity_dpct)
+{
+	int32_t t = temperature_dc - SGP30_HUMIDITY_TABLE_MIN_DC;
+	uint32_t saturation;
+
+	if (t <= 0)
+	{
+		saturation = SGP30_HUMIDITY_Saturation[0];
+	}
+
+	else if (t >= (SGP30_HUMIDITY_TABLE_SIZE - 1) * SGP30_HUMIDITY_TABLE_STEP_DC)
+	{
+		saturation = SGP30_HUMIDITY_Saturation[SGP30_HUMIDITY_TABLE_SIZE - 1];
+	}
+
+	else
+	{
+		uint8_t i = t / SGP30_HUMIDITY_TABLE_STEP_DC;
+		uint32_t fraction = t % SGP30_HUMIDITY_TABLE_STEP_DC;
+		uint32_t low = SGP30_HUMIDITY_Saturation[i];
+
+		saturation = low + (SGP30_HUMIDITY_Saturation[i + 1] - low) * fraction / SGP30_HUMIDITY_TABLE_STEP_DC;
+	}
+
+	if (humidity_dpct > 1000)
+	{
+		humidity_dpct = 1000;
+	}
+
+	uint32_t absolute = saturation * humidity_dpct / 1000;
+
+	return (absolute > SGP30_HUMIDITY_MAX_MG) ? SGP30_HUMIDITY_MAX_MG : absolute;
+}
+
+// Recomputes on every new DHT22 reading and pushes to the SGP30 between
+// IAQ measurements when the value has moved more than the threshold. A failed
+// push is retried after SGP30_HUMIDITY_RETRY_MS, not on every tick.
+void SGP30_HUMIDITY_Process()
+{
+	MODBUS_Reading reading;
+	uint16_t age_ms;
+
+	if (SAMPLER_GetReading(CONFIG_SENSOR_DHT22, &reading, &age_ms) == SAMPLER_OK)
+	{
+		uint16_t rh = DHT22_Humidity(&reading);
+		int16_t temperature = DHT22_Temperature(&reading);
+
+		if (rh != humidity_last_rh || temperature != humidity_last_temperature)
+		{
+			uint32_t absolute = SGP30_HUMIDITY_Absolute(temperature, rh);
+			uint32_t delta = (absolute > humidity_pushed_mg) ? absolute - humidity_pushed_mg : humidity_pushed_mg - absolute;
+
+			humidity_last_rh = rh;
+			humidity_last_temperature = temperature;
+
+			if (delta >= SGP30_HUMIDITY_THRESHOLD_MG)
+			{
+				humidity_pending_mg = absolute;
+				humidity_pending = 1;
+			}
+		}
+	}
+
+	if (humidity_pending && SGP30_IAQ_Idle() && (int32_t)(TIMING_GetTick() - humidity_retry_tick) >= 0)
+	{
+		// 0 would switch compensation off, a dry reading keeps the smallest step
+		uint32_t value = (humidity_pending_mg == 0) ? 1 : humidity_pending_mg;
+
+		if (sgp30_set_absolute_humidity(value) == STATUS_OK)
+		{
+			humidity_pushed_mg = humidity_pending_mg;
+			humidity_pending = 0;
+		}
+
+		else
+		{
+			humidity_failures++;
+			humidity_retry_tick = TIMING_GetTick() + SGP30_HUMIDITY_RETRY_MS;
+		}
+	}
+}
+
+// Failed set_absolute_humidity pushes since boot, wraps
+uint32_t SGP30_HUMIDITY_Failures()
+{
+	return humidity_failures;
+}
@@ -0,0 +1,30 @@
+/*
+ * sgp30_humidity.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef SENSORS_SGP30_HUMIDITY_H_
+#define SENSORS_SGP30_HUMIDITY_H_
+
+#include "stm32l1xx.h"
+
+/*
+ * Humidity compensation for the SGP30 from the DHT22 on the same station.
+ * Absolute humidity comes from a saturation vapour density table, so there
+ * is no float exp() in the loop.
+ */
+#define SGP30_HUMIDITY_TABLE_MIN_DC (-400) // -40.0 C
+#define SGP30_HUMIDITY_TABLE_STEP_DC 50 // 5.0 C
+#define SGP30_HUMIDITY_TABLE_SIZE 25 // Up to 80.0 C
+
+#define SGP30_HUMIDITY_MAX_MG 256000 // Limit of the SGP30 set_absolute_humidity command
+#define SGP30_HUMIDITY_THRESHOLD_MG 100 // Push a new value only when it moves this much
+#define SGP30_HUMIDITY_RETRY_MS 1000 // Wait after a failed push, each try blocks on I2C
+
+uint32_t SGP30_HUMIDITY_Absolute(int16_t temperature_dc, uint16_t humidity_dpct);
+void SGP30_HUMIDITY_Process();
+uint32_t SGP30_HUMIDITY_Failures();
+
+#endif /* SENSORS_SGP30_HUMIDITY_H_ */
@@ -0,0 +1,171 @@
+/*
+ * sgp30_iaq.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "sgp30_iaq.h"
+#include "sgp30.h"
+#include "i2c.h"
+
+// Set from the SysTick tick, cleared by SGP30_IAQ_Process()
+static volatile uint16_t sgp30_iaq_period_ms = 0;
+static volatile uint8_t sgp30_iaq_read_countdown = 0;
+static volatile uint8_t sgp30_iaq_measure_due = 0;
+static volatile uint8_t sgp30_iaq_read_due = 0;
+
+static volatile SGP30_IAQ_State sgp30_iaq_state = SGP30_IAQ_IDLE;
+static I2C1_Transfer sgp30_iaq_transfer;
+static uint8_t sgp30_iaq_buffer[SGP30_IAQ_RESULT_SIZE];
+
+// Latest result, only complete readings are copied here
+static volatile uint16_t sgp30_iaq_tvoc_ppb = 0;
+static volatile uint16_t sgp30_iaq_co2_eq_ppm = 0;
+static volatile uint8_t sgp30_iaq_valid = 0;
+static volatile uint8_t sgp30_iaq_last_failed = 0;
+
+// Call after sgp30_iaq_init(), the first measurement follows one period later
+void SGP30_IAQ_init()
+{
+	sgp30_iaq_state = SGP30_IAQ_IDLE;
+	sgp30_iaq_valid = 0;
+	sgp30_iaq_read_countdown = 0;
+	sgp30_iaq_read_due = 0;
+	sgp30_iaq_measure_due = 0;
+	sgp30_iaq_period_ms = 0;
+}
+
+// Called every 1 ms from SysTick_Handler
+void SGP30_IAQ_TickHandler()
+{
+	if (++sgp30_iaq_period_ms >= SGP30_IAQ_PERIOD_MS)
+	{
+		sgp30_iaq_period_ms = 0;
+		sgp30_iaq_measure_due = 1;
+	}
+
+	if (sgp30_iaq_read_countdown != 0 && --sgp30_iaq_read_countdown == 0)
+	{
+		sgp30_iaq_read_due = 1;
+	}
+}
+
+// I2C callback of the measure command, interrupt context
+static void SGP30_IAQ_CommandDone(I2C1_Transfer *transfer)
+{
+	if (transfer->status != I2C1_OK)
+	{
+		sgp30_iaq_last_failed = 1;
+		sgp30_iaq_state = SGP30_IAQ_IDLE;
+		return;
+	}
+
+	sgp30_iaq_state = SGP30_IAQ_MEASURING;
+	sgp30_iaq_read_countdown = SGP30_IAQ_READ_DELAY_MS;
+}
+
+// I2C callback of the result read, interrupt context
+static void SGP30_IAQ_ReadDone(I2C1_Transfer *transfer)
+{
+	uint8_t *data = transfer->data;
+
+	sgp30_iaq_state = SGP30_IAQ_IDLE;
+
+	if (transfer->status != I2C1_OK
+			|| sensirion_common_check_crc(&data[0], 2, data[2]) != NO_ERROR
+			|| sensirion_common_check_crc(&data[3], 2, data[5]) != NO_ERROR)
+	{
+		sgp30_iaq_last_failed = 1;
+		return;
+	}
+
+	sgp30_iaq_co2_eq_ppm = sensirion_bytes_to_uint16_t(&data[0]);
+	sgp30_iaq_tvoc_ppb = sensirion_bytes_to_uint16_t(&data[3]);
+	sgp30_iaq_valid = 1;
+	sgp30_iaq_last_failed = 0;
+}
+
+static void SGP30_IAQ_Submit(uint8_t read, uint16_t length, I2C1_Callback callback)
+{
+	sgp30_iaq_transfer.address = sgp30_get_configured_address();
+	sgp30_iaq_transfer.read = read;
+	sgp30_iaq_transfer.data = sgp30_iaq_buffer;
+	sgp30_iaq_transfer.length = length;
+	sgp30_iaq_transfer.timeout_ms = 0;
+	sgp30_iaq_transfer.callback = callback;
+
+	if (I2C1_Submit(&sgp30_iaq_transfer) != I2C1_PENDING)
+	{
+		sgp30_iaq_last_failed = 1;
+		sgp30_iaq_state = SGP30_IAQ_IDLE;
+	}
+}
+
+// Only queues transfers, the CPU never waits for the bus here
+void SGP30_IAQ_Process()
+{
+	if (sgp30_iaq_read_due)
+	{
+		sgp30_iaq_read_due = 0;
+		sgp30_iaq_state = SGP30_IAQ_READING;
+		SGP30_IAQ_Submit(1, SGP30_IAQ_RESULT_SIZE, SGP30_IAQ_ReadDone);
+	}
+
+	// The period keeps running from the tick, so a late start does not shift the next one
+	if (sgp30_iaq_measure_due && sgp30_iaq_state == SGP30_IAQ_IDLE)
+	{
+		sgp30_iaq_measure_due = 0;
+		sgp30_iaq_state = SGP30_IAQ_COMMAND;
+
+		sensirion_fill_cmd_send_buf(sgp30_iaq_buffer, SGP30_IAQ_CMD_MEASURE, NULL, 0);
+		SGP30_IAQ_Submit(0, SENSIRION_COMMAND_SIZE, SGP30_IAQ_CommandDone);
+	}
+}
+
+// Other SGP30 commands may only be sent between measurements
+uint8_t SGP30_IAQ_Idle()
+{
+	return sgp30_iaq_state == SGP30_IAQ_IDLE && !sgp30_iaq_measure_due;
+}
+
+// Time until the next measure command, 0 while one is in progress
+uint32_t SGP30_IAQ_MsUntilDue()
+{
+	if (sgp30_iaq_state != SGP30_IAQ_IDLE || sgp30_iaq_measure_due || sgp30_iaq_read_due)
+	{
+		return 0;
+	}
+
+	return SGP30_IAQ_PERIOD_MS - sgp30_iaq_period_ms;
+}
+
+// Replays ticks the SysTick interrupt missed, only while no measurement runs
+void SGP30_IAQ_AdvanceTick(uint32_t ms)
+{
+	uint32_t period = sgp30_iaq_period_ms + ms;
+
+	if (period >= SGP30_IAQ_PERIOD_MS)
+	{
+		sgp30_iaq_measure_due = 1;
+		period %= SGP30_IAQ_PERIOD_MS;
+	}
+
+	sgp30_iaq_period_ms = period;
+}
+
+// Copies the latest measurement, returns 1 when there is none or the last one failed
+uint8_t SGP30_IAQ_GetReading(MODBUS_Reading *reading)
+{
+	if (!sgp30_iaq_valid || sgp30_iaq_last_failed)
+	{
+		return 1;
+	}
+
+	__disable_irq();
+	reading->tvoc_ppb = sgp30_iaq_tvoc_ppb;
+	reading->co2_eq_ppm = sgp30_iaq_co2_eq_ppm;
+	__enable_irq();
+
+	return 0;
+}
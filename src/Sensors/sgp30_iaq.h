@@ -0,0 +1,41 @@
+/*
+ * sgp30_iaq.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef SENSORS_SGP30_IAQ_H_
+#define SENSORS_SGP30_IAQ_H_
+
+#include "stm32l1xx.h"
+#include "modbus.h"
+
+/*
+ * The SGP30 dynamic baseline algorithm needs sgp30_measure_iaq() at a steady
+ * 1 Hz, independent of how often the master polls. The SysTick tick schedules the
+ * measure command every SGP30_IAQ_PERIOD_MS and the read SGP30_IAQ_READ_DELAY_MS
+ * after it. SGP30_IAQ_Process() queues both as asynchronous I2C transfers,
+ * their callbacks advance the state.
+ */
+#define SGP30_IAQ_PERIOD_MS 1000
+#define SGP30_IAQ_READ_DELAY_MS 13 // Measurement takes 12 ms max, +1 for the tick granularity
+#define SGP30_IAQ_CMD_MEASURE 0x2008
+#define SGP30_IAQ_RESULT_SIZE 6 // CO2eq and TVOC words, each with a CRC8
+
+typedef enum {
+	SGP30_IAQ_IDLE = 0,
+	SGP30_IAQ_COMMAND = 1, // Measure command on the bus
+	SGP30_IAQ_MEASURING = 2,
+	SGP30_IAQ_READING = 3
+} SGP30_IAQ_State;
+
+void SGP30_IAQ_init();
+void SGP30_IAQ_TickHandler();
+void SGP30_IAQ_Process();
+uint8_t SGP30_IAQ_Idle();
+uint32_t SGP30_IAQ_MsUntilDue();
+void SGP30_IAQ_AdvanceTick(uint32_t ms);
+uint8_t SGP30_IAQ_GetReading(MODBUS_Reading *reading);
+
+#endif /* SENSORS_SGP30_IAQ_H_ */
@@ -0,0 +1,240 @@
+/*
+ * config.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "config.h"
+#include "adc.h"
+#include "eeprom.h"
+#include "modbus.h"
+#include "lmt84lp.h"
+#include "nsl19m51.h"
+#include "dht22.h"
+#include "sgp30.h"
+#include <stddef.h>
+
+static const STATION_Config CONFIG_Defaults = {
+	.enable_mask = (1 << CONFIG_SENSOR_COUNT) - 1,
+	.adc_sample_time = CONFIG_ADC_SAMPLE_TIME_MAX,
+	.station_address = MODBUS_STATION_ADDRESS,
+	.sensor = {
+		[CONFIG_SENSOR_LMT84LP]  = { .interval_ms = 1000, .oversampling = 6, .modbus_address = LMT84LP_MODBUS_ADDRESS },
+		[CONFIG_SENSOR_NSL19M51] = { .interval_ms = 1000, .oversampling = 6, .modbus_address = NSL19M51_MODBUS_ADDRESS },
+		[CONFIG_SENSOR_SGP30]    = { .interval_ms = 1000, .modbus_address = SGP30_MODBUS_ADDRESS },
+		[CONFIG_SENSOR_DHT22]    = { .interval_ms = 2000, .modbus_address = DHT22_MODBUS_ADDRESS },
+	},
+};
+
+static STATION_Config CONFIG_Active;
+
+// Slot holding the active record, the next save goes to the one after it
+static uint8_t CONFIG_Slot = CONFIG_SLOT_COUNT - 1;
+static uint32_t CONFIG_Sequence = 0;
+static volatile CONFIG_SaveState CONFIG_SaveResult = CONFIG_SAVE_NONE;
+
+typedef union CONFIG_SlotBuffer {
+	CONFIG_Record record;
+	uint32_t words[CONFIG_SLOT_SIZE / 4];
+} CONFIG_SlotBuffer;
+
+_Static_assert(sizeof(CONFIG_Record) <= CONFIG_SLOT_SIZE, "CONFIG_Record does not fit in an EEPROM slot");
+
+// Loads the stored record, falls back to the defaults if there is none
+void CONFIG_init()
+{
+	if (CONFIG_Load() != CONFIG_OK)
+	{
+		CONFIG_Apply(&CONFIG_Defaults);
+	}
+}
+
+const STATION_Config* CONFIG_Get()
+{
+	return &CONFIG_Active;
+}
+
+CONFIG_Status CONFIG_Validate(const STATION_Config *config)
+{
+	if (config->enable_mask >= (1 << CONFIG_SENSOR_COUNT) || config->adc_sample_time > CONFIG_ADC_SAMPLE_TIME_MAX)
+	{
+		return CONFIG_INVALID;
+	}
+
+	if (config->station_address < CONFIG_ADDRESS_MIN || config->station_address > CONFIG_ADDRESS_MAX)
+	{
+		return CONFIG_INVALID;
+	}
+
+	for (int i = 0; i < CONFIG_SENSOR_COUNT; ++i)
+	{
+		const CONFIG_Sensor *sensor = &config->sensor[i];
+
+		if (sensor->interval_ms < CONFIG_INTERVAL_MIN_MS || sensor->oversampling > CONFIG_OVERSAMPLING_MAX || sensor->filter_shift > CONFIG_FILTER_SHIFT_MAX)
+		{
+			return CONFIG_INVALID;
+		}
+
+		if (sensor->median_length > CONFIG_MEDIAN_MAX || (sensor->median_length > 1 && !(sensor->median_length & 1)) || sensor->boxcar_length > CONFIG_BOXCAR_MAX)
+		{
+			return CONFIG_INVALID;
+		}
+
+		if (sensor->modbus_address < CONFIG_ADDRESS_MIN || sensor->modbus_address > CONFIG_ADDRESS_MAX || sensor->modbus_address == config->station_address)
+		{
+			return CONFIG_INVALID;
+		}
+
+		for (int j = 0; j < i; ++j)
+		{
+			if (config->sensor[j].modbus_address == sensor->modbus_address)
+			{
+				return CONFIG_INVALID;
+			}
+		}
+	}
+
+	if (config->sensor[CONFIG_SENSOR_DHT22].interval_ms < CONFIG_DHT22_INTERVAL_MIN_MS)
+	{
+		return CONFIG_INVALID;
+	}
+
+	return CONFIG_OK;
+}
+
+// Takes effect immediately: the sampler reads intervals and the enable mask
+// from here on every pass, the ADC sample time is programmed now.
+CONFIG_Status CONFIG_Apply(const STATION_Config *config)
+{
+	if (CONFIG_Validate(config) != CONFIG_OK)
+	{
+		return CONFIG_INVALID;
+	}
+
+	CONFIG_Active = *config;
+	ADC_SetSampleTime(CONFIG_Active.adc_sample_time);
+	ADC_SetOversampling(ADC_SCAN_LMT84LP, CONFIG_Active.sensor[CONFIG_SENSOR_LMT84LP].oversampling);
+	ADC_SetOversampling(ADC_SCAN_NSL19M51, CONFIG_Active.sensor[CONFIG_SENSOR_NSL19M51].oversampling);
+
+	return CONFIG_OK;
+}
+
+uint8_t CONFIG_SensorEnabled(uint8_t sensor)
+{
+	return (CONFIG_Active.enable_mask >> sensor) & 1;
+}
+
+uint8_t CONFIG_SensorFromAddress(uint8_t address)
+{
+	for (uint8_t i = 0; i < CONFIG_SENSOR_COUNT; ++i)
+	{
+		if (CONFIG_Active.sensor[i].modbus_address == address)
+		{
+			return i;
+		}
+	}
+
+	return CONFIG_SENSOR_NONE;
+}
+
+static uint16_t CONFIG_RecordCRC(CONFIG_Record *record)
+{
+	return CRC16((uint8_t *)record, offsetof(CONFIG_Record, crc));
+}
+
+CONFIG_Status CONFIG_Load()
+{
+	static CONFIG_SlotBuffer buffer;
+	uint8_t found = 0;
+
+	for (uint8_t slot = 0; slot < CONFIG_SLOT_COUNT; ++slot)
+	{
+		EEPROM_Read(CONFIG_EEPROM_OFFSET + slot * CONFIG_SLOT_SIZE, buffer.words, CONFIG_SLOT_SIZE);
+		CONFIG_Record *record = &buffer.record;
+
+		if (record->magic != CONFIG_RECORD_MAGIC || record->version != CONFIG_RECORD_VERSION || record->length != sizeof(STATION_Config))
+		{
+			continue;
+		}
+
+		if (record->crc != CONFIG_RecordCRC(record) || CONFIG_Validate(&record->config) != CONFIG_OK)
+		{
+			continue;
+		}
+
+		if (!found || record->sequence > CONFIG_Sequence)
+		{
+			found = 1;
+			CONFIG_Slot = slot;
+			CONFIG_Sequence = record->sequence;
+			CONFIG_Active = record->config;
+		}
+	}
+
+	if (!found)
+	{
+		return CONFIG_NOT_FOUND;
+	}
+
+	return CONFIG_Apply(&CONFIG_Active);
+}
+
+CONFIG_Status CONFIG_Save()
+{
+	static CONFIG_SlotBuffer buffer;
+	uint8_t slot = (CONFIG_Slot + 1) % CONFIG_SLOT_COUNT;
+
+	for (int i = 0; i < CONFIG_SLOT_SIZE / 4; ++i)
+	{
+		buffer.words[i] = 0;
+	}
+
+	buffer.record.magic = CONFIG_RECORD_MAGIC;
+	buffer.record.version = CONFIG_RECORD_VERSION;
+	buffer.record.length = sizeof(STATION_Config);
+	buffer.record.sequence = CONFIG_Sequence + 1;
+	buffer.record.config = CONFIG_Active;
+	buffer.record.crc = CONFIG_RecordCRC(&buffer.record);
+
+	if (EEPROM_Write(CONFIG_EEPROM_OFFSET + slot * CONFIG_SLOT_SIZE, buffer.words, CONFIG_SLOT_SIZE) != EEPROM_OK)
+	{
+		return CONFIG_WRITE_ERROR;
+	}
+
+	CONFIG_Slot = slot;
+	CONFIG_Sequence = buffer.record.sequence;
+
+	return CONFIG_OK;
+}
+
+/*
+ * Programming a slot takes up to ~100 ms of blocking EEPROM writes, too long
+ * to hold a Modbus reply back. The write handler only requests the save, the
+ * main loop runs it once the reply is out.
+ */
+void CONFIG_RequestSave()
+{
+	CONFIG_SaveResult = CONFIG_SAVE_PENDING;
+}
+
+uint8_t CONFIG_SavePending()
+{
+	return CONFIG_SaveResult == CONFIG_SAVE_PENDING;
+}
+
+// Saves the active config if a save was requested, the outcome stays readable
+void CONFIG_Process()
+{
+	if (!CONFIG_SavePending())
+	{
+		return;
+	}
+
+	CONFIG_SaveResult = (CONFIG_Save() == CONFIG_OK) ? CONFIG_SAVE_DONE : CONFIG_SAVE_FAILED;
+}
+
+CONFIG_SaveState CONFIG_GetSaveState()
+{
+	return CONFIG_SaveResult;
+}
@@ -0,0 +1,99 @@
+/*
+ * config.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_config_H_
+#define UTILS_config_H_
+
+#include <stdint.h>
+
+#define CONFIG_SENSOR_COUNT 4
+
+// Sensor index, same order as the sampler table and the register map blocks
+#define CONFIG_SENSOR_LMT84LP 0
+#define CONFIG_SENSOR_NSL19M51 1
+#define CONFIG_SENSOR_SGP30 2
+#define CONFIG_SENSOR_DHT22 3
+#define CONFIG_SENSOR_NONE 0xFF
+
+#define CONFIG_INTERVAL_MIN_MS 100
+#define CONFIG_DHT22_INTERVAL_MIN_MS 2000 // Datasheet minimum between conversions
+#define CONFIG_OVERSAMPLING_MAX 8 // log2 of the number of accumulated samples
+#define CONFIG_FILTER_SHIFT_MAX 8 // EMA alpha = 1 / 2^shift, 0 = off
+#define CONFIG_MEDIAN_MAX 5 // Median window, 0 or 1 = off, otherwise odd
+#define CONFIG_BOXCAR_MAX 8 // Moving average window, 0 or 1 = off
+#define CONFIG_ADC_SAMPLE_TIME_MAX 7 // SMPx code, 7 = 384 ADC cycles
+#define CONFIG_ADDRESS_MIN 1
+#define CONFIG_ADDRESS_MAX 247 // Highest Modbus slave address
+
+/*
+ * Persistent record in the data EEPROM. Every save goes to the next of
+ * CONFIG_SLOT_COUNT slots with an incremented sequence number, and the boot
+ * loader picks the newest slot whose CRC and version check out. A torn write
+ * therefore falls back to the previous record, and erase cycles are spread
+ * over all slots.
+ */
+#define CONFIG_EEPROM_OFFSET 0x0000
+#define CONFIG_SLOT_SIZE 128
+#define CONFIG_SLOT_COUNT 8
+#define CONFIG_RECORD_MAGIC 0x53534346 // "SSCF"
+#define CONFIG_RECORD_VERSION 2
+
+typedef enum {
+	CONFIG_OK = 0,
+	CONFIG_INVALID = 1,
+	CONFIG_NOT_FOUND = 2,
+	CONFIG_WRITE_ERROR = 3
+} CONFIG_Status;
+
+// Outcome of the last deferred save, published in the station register map
+typedef enum {
+	CONFIG_SAVE_NONE = 0,
+	CONFIG_SAVE_PENDING = 1,
+	CONFIG_SAVE_DONE = 2,
+	CONFIG_SAVE_FAILED = 3
+} CONFIG_SaveState;
+
+typedef struct CONFIG_Sensor {
+	uint16_t interval_ms;
+	uint8_t oversampling; // log2, analog sensors only
+	uint8_t filter_shift;
+	uint8_t median_length;
+	uint8_t boxcar_length;
+	uint8_t modbus_address;
+	int16_t calibration_offset[2]; // Added to engineering value 0 and 1
+} CONFIG_Sensor;
+
+typedef struct STATION_Config {
+	uint16_t enable_mask; // Bit n enables sensor n
+	uint8_t adc_sample_time;
+	uint8_t station_address;
+	CONFIG_Sensor sensor[CONFIG_SENSOR_COUNT];
+} STATION_Config;
+
+typedef struct CONFIG_Record {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t length;
+	uint32_t sequence;
+	STATION_Config config;
+	uint16_t crc; // Modbus CRC16 over everything above
+} CONFIG_Record;
+
+void CONFIG_init();
+const STATION_Config* CONFIG_Get();
+CONFIG_Status CONFIG_Validate(const STATION_Config *config);
+CONFIG_Status CONFIG_Apply(const STATION_Config *config);
+uint8_t CONFIG_SensorEnabled(uint8_t sensor);
+uint8_t CONFIG_SensorFromAddress(uint8_t address);
+CONFIG_Status CONFIG_Load();
+CONFIG_Status CONFIG_Save();
+void CONFIG_RequestSave();
+uint8_t CONFIG_SavePending();
+void CONFIG_Process();
+CONFIG_SaveState CONFIG_GetSaveState();
+
+#endif /* UTILS_config_H_ */
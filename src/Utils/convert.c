@@ -0,0 +1,107 @@
+/*
+ * convert.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "convert.h"
+
+/*
+ * LMT84 output in 0.1 mV, V = 870.6 - 5.506 (T - 30) - 0.00176 (T - 30)^2 mV
+ * (LMT84 datasheet, transfer function). Voltage falls with temperature.
+ */
+static const uint16_t CONVERT_LMT84_Table[CONVERT_LMT84_TABLE_SIZE] = {
+	12998, 12474, 11946, 11415, 10880, 10342, 9800, 9255, 8706, 8154, 7598,
+	7038, 6475, 5909, 5339, 4766, 4189, 3608, 3024, 2436, 1845
+};
+
+/*
+ * NSL19M51 light in 0.01 lux, lux = 1.9634 * exp(2.1281 * V), the fit used by
+ * the master application. Linear interpolation over 50 mV stays within 0.2 %.
+ */
+static const uint32_t CONVERT_Lux_Table[CONVERT_LUX_TABLE_SIZE] = {
+	196, 218, 243, 270, 301, 334, 372, 414, 460, 512, 569, 633, 704, 783, 871,
+	969, 1077, 1198, 1333, 1483, 1649, 1834, 2040, 2269, 2524, 2807, 3122, 3473,
+	3863, 4297, 4779, 5316, 5912, 6576, 7315, 8136, 9049, 10065, 11195, 12452,
+	13850, 15405, 17135, 19058, 21198, 23578, 26225, 29170, 32445, 36087, 40139,
+	44645, 49658, 55233, 61434, 68331, 76003, 84536, 94027, 104584, 116326,
+	129386, 143912, 160069, 178041, 198030, 220263
+};
+
+// 16-bit scale ADC value to 0.1 mV. 65535 * 3600 mV * 10 fits in 32 bits.
+uint32_t CONVERT_AdcToVoltage(uint16_t value, uint16_t vdda_mv)
+{
+	return ((uint32_t)value * vdda_mv * 10) >> 16;
+}
+
+// VDDA in mV from the 12-bit factory VREFINT value and the measured VREFINT
+// on the 16-bit scale: VDDA = 3.0 V * VREFINT_CAL / VREFINT. RM0038 p.289
+uint16_t CONVERT_Vdda(uint16_t vrefint_cal, uint16_t vrefint)
+{
+	if (vrefint == 0)
+	{
+		return CONVERT_VDDA_NOMINAL_MV;
+	}
+
+	return ((uint32_t)CONVERT_CAL_VDDA_MV * vrefint_cal * 16 + vrefint / 2) / vrefint;
+}
+
+// Internal sensor in 0.01 C, the measured value is rescaled to the 3.0 V
+// calibration supply and interpolated between the 30 C and 110 C points.
+int16_t CONVERT_McuTemperature(uint16_t ts_cal1, uint16_t ts_cal2, uint16_t ts, uint16_t vdda_mv)
+{
+	int32_t ts_cal = ((uint32_t)ts * vdda_mv / CONVERT_CAL_VDDA_MV + 8) >> 4; // 12-bit at 3.0 V
+
+	if (ts_cal2 == ts_cal1)
+	{
+		return 0;
+	}
+
+	return CONVERT_TS_CAL1_CC + (ts_cal - ts_cal1) * (CONVERT_TS_CAL2_CC - CONVERT_TS_CAL1_CC) / (ts_cal2 - ts_cal1);
+}
+
+// Temperature in 0.01 C, clamped to -50 ... 150 C
+int16_t CONVERT_LMT84Temperature(uint32_t voltage_dmv)
+{
+	if (voltage_dmv >= CONVERT_LMT84_Table[0])
+	{
+		return CONVERT_LMT84_T_MIN_CC;
+	}
+
+	for (uint8_t i = 1; i < CONVERT_LMT84_TABLE_SIZE; ++i)
+	{
+		uint16_t high = CONVERT_LMT84_Table[i - 1];
+		uint16_t low = CONVERT_LMT84_Table[i];
+
+		if (voltage_dmv > low)
+		{
+			int32_t fraction = (int32_t)(high - voltage_dmv) * CONVERT_LMT84_T_STEP_CC / (high - low);
+			return CONVERT_LMT84_T_MIN_CC + (i - 1) * CONVERT_LMT84_T_STEP_CC + fraction;
+		}
+	}
+
+	return CONVERT_LMT84_T_MIN_CC + (CONVERT_LMT84_TABLE_SIZE - 1) * CONVERT_LMT84_T_STEP_CC;
+}
+
+// Illuminance in 0.1 lux
+uint16_t CONVERT_NSL19M51Lux(uint32_t voltage_dmv)
+{
+	uint32_t i = voltage_dmv / CONVERT_LUX_STEP_DMV;
+	uint32_t lux;
+
+	if (i >= CONVERT_LUX_TABLE_SIZE - 1)
+	{
+		lux = CONVERT_Lux_Table[CONVERT_LUX_TABLE_SIZE - 1];
+	}
+
+	else
+	{
+		uint32_t fraction = voltage_dmv % CONVERT_LUX_STEP_DMV;
+		uint32_t low = CONVERT_Lux_Table[i];
+
+		lux = low + (CONVERT_Lux_Table[i + 1] - low) * fraction / CONVERT_LUX_STEP_DMV;
+	}
+
+	return (lux + 5) / 10;
+}
@@ -0,0 +1,39 @@
+/*
+ * convert.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_convert_H_
+#define UTILS_convert_H_
+
+#include <stdint.h>
+
+/*
+ * Fixed-point conversion of analog readings to engineering units. Inputs are
+ * oversampled ADC values on a 16-bit scale (see oversample.h), voltages are
+ * in 0.1 mV. Only integer math and const tables, so the same code runs on a
+ * host.
+ */
+#define CONVERT_VDDA_NOMINAL_MV 3300
+#define CONVERT_CAL_VDDA_MV 3000 // Factory calibration supply
+#define CONVERT_TS_CAL1_CC 3000 // 0.01 C
+#define CONVERT_TS_CAL2_CC 11000
+
+// LMT84 transfer table, -50 C ... 150 C in 10 C steps
+#define CONVERT_LMT84_T_MIN_CC (-5000) // 0.01 C
+#define CONVERT_LMT84_T_STEP_CC 1000
+#define CONVERT_LMT84_TABLE_SIZE 21
+
+// NSL19M51 lux table, 0 ... 3.3 V in 50 mV steps
+#define CONVERT_LUX_STEP_DMV 500 // 0.1 mV
+#define CONVERT_LUX_TABLE_SIZE 67
+
+uint32_t CONVERT_AdcToVoltage(uint16_t value, uint16_t vdda_mv);
+uint16_t CONVERT_Vdda(uint16_t vrefint_cal, uint16_t vrefint);
+int16_t CONVERT_McuTemperature(uint16_t ts_cal1, uint16_t ts_cal2, uint16_t ts, uint16_t vdda_mv);
+int16_t CONVERT_LMT84Temperature(uint32_t voltage_dmv);
+uint16_t CONVERT_NSL19M51Lux(uint32_t voltage_dmv);
+
+#endif /* UTILS_convert_H_ */
@@ -0,0 +1,54 @@
+/*
+ * events.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "events.h"
+
+static volatile uint32_t event_pending = 0;
+
+// Safe from any interrupt priority
+void EVENT_Post(uint32_t events)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	event_pending |= events;
+	__set_PRIMASK(primask);
+}
+
+uint32_t EVENT_Take(void)
+{
+	uint32_t events;
+
+	__disable_irq();
+	events = event_pending;
+	event_pending = 0;
+	__enable_irq();
+
+	return events;
+}
+
+uint8_t EVENT_Pending(void)
+{
+	return event_pending != 0;
+}
+
+// Sleep mode until the next interrupt. WFI is entered with interrupts
+// masked: a pending interrupt still wakes the core, so an event posted
+// after the check cannot be slept through. The handler runs once they
+// are unmasked again. PM0056 p.28
+void EVENT_WaitForEvent(void)
+{
+	__disable_irq();
+
+	if (event_pending == 0)
+	{
+		__DSB();
+		__WFI();
+	}
+
+	__enable_irq();
+}
@@ -0,0 +1,29 @@
+/*
+ * events.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_events_H_
+#define UTILS_events_H_
+
+#include "stm32l1xx.h"
+
+/*
+ * Event flags for the main loop. Interrupt handlers post what happened,
+ * main() takes the whole set, runs the matching work and sleeps with WFI
+ * once nothing is left. An event posted twice before it is taken is only
+ * handled once, so the handlers must drain everything that is ready.
+ */
+#define EVENT_MODBUS_FRAME 0x0001 // Frame delimited by t3.5, or a reply left the line
+#define EVENT_TICK 0x0002 // SysTick millisecond tick
+#define EVENT_SAMPLE_DONE 0x0004 // Split-phase conversion finished
+#define EVENT_I2C_DONE 0x0008 // I2C1 transfer finished
+
+void EVENT_Post(uint32_t events);
+uint32_t EVENT_Take(void);
+uint8_t EVENT_Pending(void);
+void EVENT_WaitForEvent(void);
+
+#endif /* UTILS_events_H_ */
@@ -0,0 +1,114 @@
+/*
+ * filter.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "filter.h"
+
+void FILTER_Reset(FILTER_State *state, const FILTER_Config *config)
+{
+	state->config = *config;
+	state->median_count = 0;
+	state->median_pos = 0;
+	state->ema = 0;
+	state->ema_valid = 0;
+	state->boxcar_sum = 0;
+	state->boxcar_count = 0;
+	state->boxcar_pos = 0;
+}
+
+// Median of the last up to config->median samples. Until the window has
+// filled, the median of what there is.
+static int32_t FILTER_Median(FILTER_State *state, uint8_t length, int32_t sample)
+{
+	int32_t sorted[FILTER_MEDIAN_MAX];
+
+	state->median_window[state->median_pos] = sample;
+	state->median_pos = (state->median_pos + 1) % length;
+
+	if (state->median_count < length)
+	{
+		state->median_count++;
+	}
+
+	// Insertion sort, at most 5 entries
+	for (uint8_t i = 0; i < state->median_count; ++i)
+	{
+		int32_t value = state->median_window[i];
+		uint8_t j = i;
+
+		while (j > 0 && sorted[j - 1] > value)
+		{
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+
+		sorted[j] = value;
+	}
+
+	return sorted[state->median_count / 2];
+}
+
+static int32_t FILTER_Ema(FILTER_State *state, uint8_t shift, int32_t sample)
+{
+	if (!state->ema_valid)
+	{
+		state->ema = sample * (1 << shift);
+		state->ema_valid = 1;
+		return sample;
+	}
+
+	int32_t half = 1 << (shift - 1);
+
+	// Rounded, not floored, so a negative step settles on its target too
+	state->ema += sample - ((state->ema + half) >> shift);
+
+	return (state->ema + half) >> shift;
+}
+
+static int32_t FILTER_Boxcar(FILTER_State *state, uint8_t length, int32_t sample)
+{
+	if (state->boxcar_count == length)
+	{
+		state->boxcar_sum -= state->boxcar_window[state->boxcar_pos];
+	}
+	else
+	{
+		state->boxcar_count++;
+	}
+
+	state->boxcar_window[state->boxcar_pos] = sample;
+	state->boxcar_sum += sample;
+	state->boxcar_pos = (state->boxcar_pos + 1) % length;
+
+	return state->boxcar_sum / state->boxcar_count;
+}
+
+// Runs one sample through the enabled stages. A config change restarts the
+// pipeline, so old samples never mix with a new window length.
+int32_t FILTER_Apply(FILTER_State *state, const FILTER_Config *config, int32_t sample)
+{
+	if (state->config.median != config->median || state->config.ema_shift != config->ema_shift || state->config.boxcar != config->boxcar)
+	{
+		FILTER_Reset(state, config);
+	}
+
+	if (config->median > 1)
+	{
+		sample = FILTER_Median(state, config->median, sample);
+	}
+
+	if (config->ema_shift > 0)
+	{
+		sample = FILTER_Ema(state, config->ema_shift, sample);
+	}
+
+	if (config->boxcar > 1)
+	{
+		sample = FILTER_Boxcar(state, config->boxcar, sample);
+	}
+
+	return sample;
+}
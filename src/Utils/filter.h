@@ -0,0 +1,45 @@
+/*
+ * filter.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_filter_H_
+#define UTILS_filter_H_
+
+#include <stdint.h>
+
+/*
+ * Per-channel filter pipeline on integer samples:
+ * median-of-N spike rejection -> EMA (alpha = 1 / 2^shift) -> boxcar mean.
+ * Every stage is off at length / shift 0. Static memory only and no hardware
+ * access, so the pipeline can be fed recorded vectors on a host.
+ */
+#define FILTER_MEDIAN_MAX 5 // Odd window, 3 or 5
+#define FILTER_EMA_SHIFT_MAX 8
+#define FILTER_BOXCAR_MAX 8
+
+typedef struct FILTER_Config {
+	uint8_t median;
+	uint8_t ema_shift;
+	uint8_t boxcar;
+} FILTER_Config;
+
+typedef struct FILTER_State {
+	FILTER_Config config; // Settings the state was built for
+	int32_t median_window[FILTER_MEDIAN_MAX];
+	uint8_t median_count;
+	uint8_t median_pos;
+	int32_t ema; // Scaled by 2^ema_shift
+	uint8_t ema_valid;
+	int32_t boxcar_window[FILTER_BOXCAR_MAX];
+	int32_t boxcar_sum;
+	uint8_t boxcar_count;
+	uint8_t boxcar_pos;
+} FILTER_State;
+
+void FILTER_Reset(FILTER_State *state, const FILTER_Config *config);
+int32_t FILTER_Apply(FILTER_State *state, const FILTER_Config *config, int32_t sample);
+
+#endif /* UTILS_filter_H_ */
@@ -0,0 +1,36 @@
+/*
+ * oversample.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "oversample.h"
+
+void OVERSAMPLE_Init(OVERSAMPLE_Channel *channel, uint8_t log2)
+{
+	channel->sum = 0;
+	channel->count = 0;
+	channel->log2 = (log2 > OVERSAMPLE_LOG2_MAX) ? OVERSAMPLE_LOG2_MAX : log2;
+	channel->ready = 0;
+	channel->result = 0;
+}
+
+// Returns 1 when the sample completed a block and result was updated
+uint8_t OVERSAMPLE_Add(OVERSAMPLE_Channel *channel, uint16_t sample)
+{
+	channel->sum += sample;
+
+	if (++channel->count < (1 << channel->log2))
+	{
+		return 0;
+	}
+
+	// Max 4095 * 256 << 4 fits in 32 bits
+	channel->result = (channel->sum << (OVERSAMPLE_OUTPUT_BITS - OVERSAMPLE_INPUT_BITS)) >> channel->log2;
+	channel->ready = 1;
+	channel->sum = 0;
+	channel->count = 0;
+
+	return 1;
+}
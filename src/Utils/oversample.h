@@ -0,0 +1,35 @@
+/*
+ * oversample.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_oversample_H_
+#define UTILS_oversample_H_
+
+#include <stdint.h>
+
+/*
+ * Accumulate-and-decimate for 12-bit ADC samples. 2^log2 samples are summed
+ * and the sum is scaled to a 16-bit full scale (0 ... 65520), so the result
+ * has the same scale for every ratio: 4 samples give 13 effective bits,
+ * 16 give 14 and 256 give 16. No hardware access, the ADC DMA interrupt
+ * feeds it on the device and any sample source can on a host.
+ */
+#define OVERSAMPLE_INPUT_BITS 12
+#define OVERSAMPLE_OUTPUT_BITS 16
+#define OVERSAMPLE_LOG2_MAX 8
+
+typedef struct OVERSAMPLE_Channel {
+	uint32_t sum;
+	uint16_t count;
+	uint8_t log2;
+	uint8_t ready; // Set once the first full block has been decimated
+	uint16_t result;
+} OVERSAMPLE_Channel;
+
+void OVERSAMPLE_Init(OVERSAMPLE_Channel *channel, uint8_t log2);
+uint8_t OVERSAMPLE_Add(OVERSAMPLE_Channel *channel, uint16_t sample);
+
+#endif /* UTILS_oversample_H_ */
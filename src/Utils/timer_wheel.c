@@ -0,0 +1,227 @@
+/*
+ * timer_wheel.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "timer_wheel.h"
+
+// One list per slot, plus the list of timers expiring on the current tick
+#define TWHEEL_BUCKETS (TWHEEL_LEVELS * TWHEEL_SLOTS)
+#define TWHEEL_EXPIRED TWHEEL_BUCKETS
+
+static TWHEEL_Timer twheel_pool[TWHEEL_MAX_TIMERS];
+static uint8_t twheel_head[TWHEEL_BUCKETS + 1];
+static uint32_t twheel_now = 0; // Last processed tick
+static uint8_t twheel_active = 0;
+
+void TWHEEL_Init(uint32_t now)
+{
+	for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+	{
+		twheel_pool[i].used = 0;
+		twheel_pool[i].bucket = TWHEEL_NONE;
+	}
+
+	for (int i = 0; i <= TWHEEL_BUCKETS; ++i)
+	{
+		twheel_head[i] = TWHEEL_NONE;
+	}
+
+	twheel_now = now;
+	twheel_active = 0;
+}
+
+TWHEEL_Id TWHEEL_Create(TWHEEL_Callback callback, void *arg)
+{
+	for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+	{
+		if (!twheel_pool[i].used)
+		{
+			twheel_pool[i].used = 1;
+			twheel_pool[i].callback = callback;
+			twheel_pool[i].arg = arg;
+			twheel_pool[i].bucket = TWHEEL_NONE;
+			return i;
+		}
+	}
+
+	return TWHEEL_INVALID;
+}
+
+static void TWHEEL_Link(TWHEEL_Id id, uint8_t bucket)
+{
+	TWHEEL_Timer *timer = &twheel_pool[id];
+
+	timer->bucket = bucket;
+	timer->prev = TWHEEL_NONE;
+	timer->next = twheel_head[bucket];
+
+	if (timer->next != TWHEEL_NONE)
+	{
+		twheel_pool[timer->next].prev = id;
+	}
+
+	twheel_head[bucket] = id;
+	twheel_active++;
+}
+
+static void TWHEEL_Unlink(TWHEEL_Id id)
+{
+	TWHEEL_Timer *timer = &twheel_pool[id];
+
+	if (timer->prev != TWHEEL_NONE)
+	{
+		twheel_pool[timer->prev].next = timer->next;
+	}
+	else
+	{
+		twheel_head[timer->bucket] = timer->next;
+	}
+
+	if (timer->next != TWHEEL_NONE)
+	{
+		twheel_pool[timer->next].prev = timer->prev;
+	}
+
+	timer->bucket = TWHEEL_NONE;
+	twheel_active--;
+}
+
+// Files the timer by how far away it expires. Slots are indexed by the
+// expiry's own bits, so a slot is reached exactly when the wheel gets to it.
+static void TWHEEL_Insert(TWHEEL_Id id)
+{
+	uint32_t expires = twheel_pool[id].expires;
+	int32_t delta = (int32_t)(expires - twheel_now);
+
+	if (delta < 0)
+	{
+		expires = twheel_now; // Overdue after a cascade, runs on this tick
+		delta = 0;
+	}
+
+	else if ((uint32_t)delta >= TWHEEL_RANGE)
+	{
+		expires = twheel_now + TWHEEL_RANGE - 1; // Re-filed when this slot cascades
+		delta = TWHEEL_RANGE - 1;
+	}
+
+	for (uint8_t level = 0; level < TWHEEL_LEVELS; ++level)
+	{
+		uint8_t shift = level * TWHEEL_SLOT_BITS;
+
+		if ((uint32_t)delta < (1UL << (shift + TWHEEL_SLOT_BITS)))
+		{
+			TWHEEL_Link(id, level * TWHEEL_SLOTS + ((expires >> shift) & TWHEEL_SLOT_MASK));
+			return;
+		}
+	}
+}
+
+// A delay of 0 runs on the next tick
+void TWHEEL_Start(TWHEEL_Id id, uint32_t delay, uint32_t period)
+{
+	if (id >= TWHEEL_MAX_TIMERS || !twheel_pool[id].used)
+	{
+		return;
+	}
+
+	if (twheel_pool[id].bucket != TWHEEL_NONE)
+	{
+		TWHEEL_Unlink(id);
+	}
+
+	twheel_pool[id].expires = twheel_now + (delay ? delay : 1);
+	twheel_pool[id].period = period;
+	TWHEEL_Insert(id);
+}
+
+void TWHEEL_Cancel(TWHEEL_Id id)
+{
+	if (id < TWHEEL_MAX_TIMERS && twheel_pool[id].bucket != TWHEEL_NONE)
+	{
+		TWHEEL_Unlink(id);
+	}
+}
+
+uint8_t TWHEEL_Active(TWHEEL_Id id)
+{
+	return id < TWHEEL_MAX_TIMERS && twheel_pool[id].bucket != TWHEEL_NONE;
+}
+
+// Moves every timer of a slot one or more levels down
+static void TWHEEL_Cascade(uint8_t bucket)
+{
+	while (twheel_head[bucket] != TWHEEL_NONE)
+	{
+		TWHEEL_Id id = twheel_head[bucket];
+
+		TWHEEL_Unlink(id);
+		TWHEEL_Insert(id);
+	}
+}
+
+// Runs the callbacks of one tick. The expired timers are moved to their own
+// list first, so a callback cancelling one of them is still safe.
+static void TWHEEL_Expire(uint8_t bucket)
+{
+	while (twheel_head[bucket] != TWHEEL_NONE)
+	{
+		TWHEEL_Id id = twheel_head[bucket];
+
+		TWHEEL_Unlink(id);
+		TWHEEL_Link(id, TWHEEL_EXPIRED);
+	}
+
+	while (twheel_head[TWHEEL_EXPIRED] != TWHEEL_NONE)
+	{
+		TWHEEL_Id id = twheel_head[TWHEEL_EXPIRED];
+		TWHEEL_Timer *timer = &twheel_pool[id];
+
+		TWHEEL_Unlink(id);
+
+		if (timer->period != 0)
+		{
+			// Keeps the period phase, missed periods are skipped
+			timer->expires += timer->period;
+			if ((int32_t)(timer->expires - twheel_now) <= 0)
+			{
+				timer->expires = twheel_now + 1;
+			}
+
+			TWHEEL_Insert(id);
+		}
+
+		timer->callback(timer->arg);
+	}
+}
+
+// Advances the wheel tick by tick up to now, callbacks run in expiry order
+void TWHEEL_Process(uint32_t now)
+{
+	while (twheel_now != now)
+	{
+		// Nothing to run on the way, skip the idle ticks in one go
+		if (twheel_active == 0)
+		{
+			twheel_now = now;
+			return;
+		}
+
+		twheel_now++;
+
+		for (uint8_t level = TWHEEL_LEVELS - 1; level > 0; --level)
+		{
+			uint8_t shift = level * TWHEEL_SLOT_BITS;
+
+			if ((twheel_now & ((1UL << shift) - 1)) == 0)
+			{
+				TWHEEL_Cascade(level * TWHEEL_SLOTS + ((twheel_now >> shift) & TWHEEL_SLOT_MASK));
+			}
+		}
+
+		TWHEEL_Expire(twheel_now & TWHEEL_SLOT_MASK);
+	}
+}
@@ -0,0 +1,60 @@
+/*
+ * timer_wheel.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef UTILS_timer_wheel_H_
+#define UTILS_timer_wheel_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Hierarchical timer wheel, three levels of 64 slots. Level 0 holds timers
+ * due within 64 ticks, level 1 within 4096 and level 2 within 262144, a
+ * timer moves down a level whenever the wheel turns past its slot. Later
+ * timers wait in the last level and are re-filed until they are in range.
+ *
+ * Timers come from a static pool and are linked into their slot by index,
+ * so start and cancel are O(1). The caller supplies the time: in the
+ * firmware TWHEEL_Process() runs from the main loop with TIMING_GetTick(),
+ * on a host any simulated clock will do. Callbacks run from
+ * TWHEEL_Process() and may start or cancel any timer, themselves included.
+ *
+ * Delays count from the last TWHEEL_Process() call and must stay below
+ * 2^31 ticks.
+ */
+#define TWHEEL_MAX_TIMERS 16
+#define TWHEEL_LEVELS 3
+#define TWHEEL_SLOT_BITS 6
+#define TWHEEL_SLOTS (1 << TWHEEL_SLOT_BITS)
+#define TWHEEL_SLOT_MASK (TWHEEL_SLOTS - 1)
+#define TWHEEL_RANGE (1UL << (TWHEEL_LEVELS * TWHEEL_SLOT_BITS)) // Ticks covered without re-filing
+
+#define TWHEEL_NONE 0xFF // Empty list / unlinked timer
+#define TWHEEL_INVALID 0xFF // No timer, TWHEEL_Create() ran out of the pool
+
+typedef uint8_t TWHEEL_Id;
+typedef void (*TWHEEL_Callback)(void *arg);
+
+typedef struct TWHEEL_Timer {
+	uint32_t expires; // Absolute tick
+	uint32_t period; // 0 = one-shot
+	TWHEEL_Callback callback;
+	void *arg;
+	uint8_t bucket; // Slot list the timer is linked into, TWHEEL_NONE when stopped
+	uint8_t next;
+	uint8_t prev;
+	uint8_t used;
+} TWHEEL_Timer;
+
+void TWHEEL_Init(uint32_t now);
+TWHEEL_Id TWHEEL_Create(TWHEEL_Callback callback, void *arg);
+void TWHEEL_Start(TWHEEL_Id id, uint32_t delay, uint32_t period);
+void TWHEEL_Cancel(TWHEEL_Id id);
+uint8_t TWHEEL_Active(TWHEEL_Id id);
+void TWHEEL_Process(uint32_t now);
+
+#endif /* UTILS_timer_wheel_H_ */
@@ -1,30 +1,139 @@
 #include "timing.h"
 #include "stm32l1xx.h"
+#include "events.h"
 
-void delay_us(unsigned long delay)
+static volatile uint64_t timing_ms = 0;
+static volatile uint16_t timing_carry_us = 0; // Partial periods cut short by clock changes
+
+// Call once after SystemCoreClockUpdate(), clock changes go through TIMING_ClockChanged()
+void TIMING_Init(void)
 {
-	unsigned long i = 0;
-	SysTick->LOAD = 32 - 1; //32 000 000 = 1s so 32 = 1 us
+	SysTick->CTRL = 0;
+	SysTick->LOAD = SystemCoreClock / TIMING_TICK_HZ - 1; //32 000 000 = 1s so 32 000 = 1 ms
 	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
+	NVIC_SetPriority(SysTick_IRQn, 0);
+	SysTick->CTRL = 7;				//processor clock, interrupt, enable. M3 Generic User Guide p. 159
+}
+
+// Reloads SysTick for the new SystemCoreClock. The elapsed part of the
+// running period is kept in timing_carry_us, so no time is lost.
+void TIMING_ClockChanged(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	// A pending reload is counted by the interrupt, nothing of it is left
+	if (!(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk))
+	{
+		timing_carry_us += (SysTick->LOAD - SysTick->VAL) * 1000 / (SysTick->LOAD + 1);
+		if (timing_carry_us >= 1000)
+		{
+			timing_carry_us -= 1000;
+			timing_ms++;
+		}
+	}
+
+	SysTick->LOAD = SystemCoreClock / TIMING_TICK_HZ - 1;
+	SysTick->VAL = 0;				//restarts the period, no interrupt
 
-	  while(i < delay)
-	  {
-		  while(!((SysTick->CTRL) & 0x10000)){}
-		  i++;
-	  }
+	__set_PRIMASK(primask);
 }
 
-void delay_ms(unsigned long delay)
+// Called every 1 ms from SysTick_Handler, wakes the main loop for its timed work
+void TIMING_SysTickHandler(void)
 {
-	unsigned long i = 0;
-	SysTick->LOAD = 32000 - 1; //32 000 000 = 1s so 32 000 = 1 ms
-	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
-		  
-	while(i < delay)
-	{	
-		while(!((SysTick->CTRL) & 0x10000)){} //M3 Generic User Guide p. 159
-		i++;
+	timing_ms++;
+	EVENT_Post(EVENT_TICK);
+}
+
+// SysTick stops in Stop mode, the power manager adds the time it slept
+void TIMING_AdvanceMillis(uint32_t ms)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	timing_ms += ms;
+	__set_PRIMASK(primask);
+}
+
+uint64_t TIMING_Millis(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint64_t ms;
+
+	__disable_irq();
+	ms = timing_ms;
+	__set_PRIMASK(primask);
+
+	return ms;
+}
+
+// The low word is read with a single load, no masking needed
+uint32_t TIMING_GetTick(void)
+{
+	return (uint32_t)timing_ms;
+}
+
+uint32_t TIMING_Micros(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	uint32_t ms, val, load;
+
+	__disable_irq();
+	ms = (uint32_t)timing_ms;
+	load = SysTick->LOAD;
+	val = SysTick->VAL;
+
+	// SysTick reloaded but its interrupt has not run yet, e.g. when called
+	// with interrupts disabled. VAL is read again so it is surely past the reload.
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+	{
+		val = SysTick->VAL;
+		ms++;
 	}
+	ms = ms * 1000 + timing_carry_us;
+	__set_PRIMASK(primask);
+
+	return ms + (load - val) * 1000 / (load + 1);
+}
+
+uint32_t TIMING_DeadlineUs(uint32_t timeout_us)
+{
+	return TIMING_Micros() + timeout_us;
+}
+
+uint8_t TIMING_Expired(uint32_t deadline_us)
+{
+	return (int32_t)(TIMING_Micros() - deadline_us) >= 0;
+}
+
+uint32_t TIMING_ElapsedUs(uint32_t start_us)
+{
+	return TIMING_Micros() - start_us;
+}
+
+uint64_t TIMING_DeadlineMs(uint32_t timeout_ms)
+{
+	return TIMING_Millis() + timeout_ms;
+}
+
+uint8_t TIMING_ExpiredMs(uint64_t deadline_ms)
+{
+	return TIMING_Millis() >= deadline_ms;
+}
+
+// Busy waits, but no longer touch SysTick so they can be used anywhere
+void delay_us(unsigned long delay)
+{
+	uint32_t start = TIMING_Micros();
+
+	while (TIMING_ElapsedUs(start) < delay) {}
+}
+
+void delay_ms(unsigned long delay)
+{
+	uint64_t deadline = TIMING_Millis() + delay + 1; // The current ms has already started
+
+	while (TIMING_Millis() < deadline) {}
 }
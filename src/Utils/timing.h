@@ -8,6 +8,36 @@
 #ifndef UTILS_timing_H_
 #define UTILS_timing_H_
 
+#include "stm32l1xx.h"
+
+/*
+ * Monotonic timebase. SysTick interrupts every 1 ms and counts a 64-bit
+ * millisecond clock, the microsecond clock adds the elapsed part of the
+ * current SysTick period. Nothing else may reprogram SysTick, a new core
+ * clock is picked up with TIMING_ClockChanged().
+ *
+ * The microsecond clock wraps after ~71 minutes, so compare microsecond
+ * times only through the helpers below, they work across the wrap for
+ * intervals up to half of it. TIMING_GetTick() is the millisecond clock cut
+ * to 32 bits for the same kind of unsigned differences in the drivers.
+ */
+#define TIMING_TICK_HZ 1000
+
+void TIMING_Init(void);
+void TIMING_ClockChanged(void);
+void TIMING_SysTickHandler(void);
+
+uint64_t TIMING_Millis(void);
+uint32_t TIMING_GetTick(void);
+uint32_t TIMING_Micros(void);
+void TIMING_AdvanceMillis(uint32_t ms);
+
+uint32_t TIMING_DeadlineUs(uint32_t timeout_us);
+uint8_t TIMING_Expired(uint32_t deadline_us);
+uint32_t TIMING_ElapsedUs(uint32_t start_us);
+uint64_t TIMING_DeadlineMs(uint32_t timeout_ms);
+uint8_t TIMING_ExpiredMs(uint64_t deadline_ms);
+
 void delay_us(unsigned long delay); 
 void delay_ms(unsigned long delay); 
 
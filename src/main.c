@@ -11,9 +11,19 @@
 #include "nsl19m51.h"
 #include "dht22.h"
 #include "sgp30.h"
+#include "sampler.h"
+#include "sgp30_baseline.h"
+#include "sgp30_iaq.h"
+#include "sgp30_humidity.h"
+#include "rtc.h"
 
 #include "timing.h"
 #include "timers.h"
+#include "config.h"
+#include "timer_wheel.h"
+#include "events.h"
+#include "power.h"
+#include "clock.h"
 
 #include <stdio.h>
 
@@ -23,27 +33,84 @@ int main(void)
 {
 	SetSysClock();
 	SystemCoreClockUpdate();
-
-	// Utils Initializations
+	CLOCK_init();
+	TIMING_Init();
 
 	// Peripheral Initializations
 	GPIO_init();
 	USART1_init();
+	MODBUS_init();
 	USART2_init();
 	TIM2_Init();
+	TIM6_Init();
 	ADC_init();
 
+	RTC_init();
+
+	// Utils Initializations
+	CONFIG_init();
+	TWHEEL_Init(TIMING_GetTick());
+
 	// Sensor Initializations
     sensirion_i2c_init(); // SGP30
+    SGP30_BASELINE_init();
+    SGP30_IAQ_init();
 	LMT84LP_init();
 	NSL19M51_init();
 	DHT22_init();
 
+	SAMPLER_init();
+	POWER_init();
+
 	MODBUS_RE_TE_LOW();
 
+	// Everything below is started by an interrupt, the core sleeps in between.
+	// The SysTick tick wakes it every 1 ms for the time-based work, unless
+	// the power manager found room for Stop mode.
     while (1)
     {
-		MODBUS_ProcessFrame();
+		uint32_t events = EVENT_Take();
+
+		// Requests and sampling run on the PLL, the rest on MSI
+		if (events & EVENT_MODBUS_FRAME)
+		{
+			// Answered on MSI when the clock cannot step up right now
+			CLOCK_Boost();
+			MODBUS_ProcessFrame();
+			POWER_NoteActivity();
+		}
+
+		if (events & EVENT_TICK)
+		{
+			TWHEEL_Process(TIMING_GetTick());
+		}
+
+		if (events & (EVENT_TICK | EVENT_SAMPLE_DONE | EVENT_I2C_DONE))
+		{
+			// A frame on the line or a queued I2C transfer delays sampling by a tick
+			if (SAMPLER_MsUntilDue() == 0 && CLOCK_Boost())
+			{
+				SAMPLER_Process();
+			}
+		}
+
+		if (events & (EVENT_TICK | EVENT_I2C_DONE))
+		{
+			I2C1_Process();
+			SGP30_IAQ_Process();
+			SGP30_HUMIDITY_Process();
+			SGP30_BASELINE_Process();
+		}
+
+		// The EEPROM write blocks for up to ~100 ms, so it waits until the
+		// reply to the save request has left and no other frame is pending
+		if (CONFIG_SavePending() && !MODBUS_Busy())
+		{
+			CONFIG_Process();
+		}
+
+		CLOCK_ScaleDown();
+		POWER_Idle();
     }
 
     return 0;
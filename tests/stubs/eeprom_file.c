@@ -0,0 +1,121 @@
+/*
+ * eeprom_file.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "eeprom.h"
+#include "eeprom_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static FILE *eeprom_file = NULL;
+static uint32_t eeprom_word_writes = 0;
+static uint8_t eeprom_fail_writes = 0;
+
+void EEPROM_FILE_Open(const char *path)
+{
+	eeprom_file = fopen(path, "r+b");
+
+	if (eeprom_file == NULL)
+	{
+		eeprom_file = fopen(path, "w+b");
+		if (eeprom_file == NULL)
+		{
+			perror(path);
+			exit(2);
+		}
+		EEPROM_FILE_Erase();
+	}
+
+	eeprom_word_writes = 0;
+	eeprom_fail_writes = 0;
+}
+
+void EEPROM_FILE_Erase()
+{
+	static const uint8_t erased[EEPROM_SIZE];
+
+	fseek(eeprom_file, 0, SEEK_SET);
+	fwrite(erased, 1, EEPROM_SIZE, eeprom_file);
+	fflush(eeprom_file);
+}
+
+void EEPROM_FILE_Close()
+{
+	if (eeprom_file != NULL)
+	{
+		fclose(eeprom_file);
+		eeprom_file = NULL;
+	}
+}
+
+uint32_t EEPROM_FILE_WordWrites()
+{
+	return eeprom_word_writes;
+}
+
+void EEPROM_FILE_FailWrites(uint8_t fail)
+{
+	eeprom_fail_writes = fail;
+}
+
+uint32_t EEPROM_ReadWord(uint32_t offset)
+{
+	uint32_t word = 0;
+
+	fseek(eeprom_file, offset, SEEK_SET);
+	if (fread(&word, 4, 1, eeprom_file) != 1)
+	{
+		return 0;
+	}
+
+	return word;
+}
+
+void EEPROM_Read(uint32_t offset, void *data, uint32_t length)
+{
+	uint32_t *words = data;
+
+	for (uint32_t i = 0; i < length / 4; ++i)
+	{
+		words[i] = EEPROM_ReadWord(offset + 4 * i);
+	}
+}
+
+// Same skip-unchanged behaviour as the real driver
+EEPROM_Status EEPROM_Write(uint32_t offset, const void *data, uint32_t length)
+{
+	const uint32_t *words = data;
+
+	if ((offset & 3) || (length & 3) || offset + length > EEPROM_SIZE)
+	{
+		return EEPROM_OUT_OF_RANGE;
+	}
+
+	if (eeprom_fail_writes)
+	{
+		return EEPROM_TIMEOUT;
+	}
+
+	for (uint32_t i = 0; i < length / 4; ++i)
+	{
+		if (EEPROM_ReadWord(offset + 4 * i) == words[i])
+		{
+			continue;
+		}
+
+		fseek(eeprom_file, offset + 4 * i, SEEK_SET);
+		if (fwrite(&words[i], 4, 1, eeprom_file) != 1)
+		{
+			return EEPROM_ERROR;
+		}
+		eeprom_word_writes++;
+	}
+
+	fflush(eeprom_file);
+
+	return EEPROM_OK;
+}
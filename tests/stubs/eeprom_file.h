@@ -0,0 +1,29 @@
+/*
+ * eeprom_file.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef TESTS_EEPROM_FILE_H_
+#define TESTS_EEPROM_FILE_H_
+
+#include <stdint.h>
+
+/*
+ * Host stand-in for Peripherals/eeprom.c. The data EEPROM is a file of
+ * EEPROM_SIZE bytes, created erased (all zero, like the STM32L1 data
+ * EEPROM) when it does not exist yet. EEPROM_Read/Write keep the word
+ * alignment rules of the real driver.
+ */
+void EEPROM_FILE_Open(const char *path);
+void EEPROM_FILE_Erase();
+void EEPROM_FILE_Close();
+
+// Number of words actually programmed since the file was opened
+uint32_t EEPROM_FILE_WordWrites();
+
+// Makes every following EEPROM_Write() time out, as a stuck BSY flag would
+void EEPROM_FILE_FailWrites(uint8_t fail);
+
+#endif /* TESTS_EEPROM_FILE_H_ */
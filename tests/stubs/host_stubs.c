@@ -0,0 +1,40 @@
+/*
+ * host_stubs.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include <stdint.h>
+
+// Hardware hooks the host-tested modules call, recorded for inspection
+
+uint8_t host_adc_sample_time = 0xFF;
+uint8_t host_adc_oversampling[8];
+
+void ADC_SetSampleTime(uint8_t code)
+{
+	host_adc_sample_time = code;
+}
+
+void ADC_SetOversampling(uint8_t index, uint8_t log2)
+{
+	host_adc_oversampling[index] = log2;
+}
+
+// Bitwise Modbus CRC16, same result as the table version in modbus.c
+uint16_t CRC16(uint8_t *nData, uint16_t wLength)
+{
+	uint16_t crc = 0xFFFF;
+
+	while (wLength--)
+	{
+		crc ^= *nData++;
+		for (int i = 0; i < 8; ++i)
+		{
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+		}
+	}
+
+	return crc;
+}
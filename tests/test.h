@@ -0,0 +1,47 @@
+/*
+ * test.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#ifndef TESTS_TEST_H_
+#define TESTS_TEST_H_
+
+#include <stdio.h>
+
+// Minimal host test harness: a failed check is reported and counted, the
+// test program returns the count so make stops on the first failing binary.
+
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_CHECK_EQ(actual, expected) \
+	do { \
+		long long test_a = (long long)(actual); \
+		long long test_e = (long long)(expected); \
+		if (test_a != test_e) \
+		{ \
+			printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, test_a, test_e); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_RUN(test) \
+	do { \
+		int test_before = test_failures; \
+		test(); \
+		printf("%s %s\n", (test_failures == test_before) ? "PASS" : "FAIL", #test); \
+	} while (0)
+
+#define TEST_RESULT() (test_failures ? 1 : 0)
+
+#endif /* TESTS_TEST_H_ */
@@ -0,0 +1,227 @@
+/*
+ * test_config.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "test.h"
+#include "eeprom_file.h"
+#include "config.h"
+#include "eeprom.h"
+#include "modbus.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_EEPROM_PATH "build/test_config.eeprom"
+
+extern uint8_t host_adc_sample_time;
+
+// Captured on the first boot, the base of every crafted record
+static STATION_Config test_defaults;
+
+typedef union TEST_Slot {
+	CONFIG_Record record;
+	uint32_t words[CONFIG_SLOT_SIZE / 4];
+} TEST_Slot;
+
+static uint32_t TEST_SlotOffset(uint8_t slot)
+{
+	return CONFIG_EEPROM_OFFSET + slot * CONFIG_SLOT_SIZE;
+}
+
+// Writes a valid record the way CONFIG_Save() lays it out
+static void TEST_WriteSlot(uint8_t slot, uint32_t sequence, uint8_t station_address)
+{
+	TEST_Slot buffer;
+
+	memset(&buffer, 0, sizeof(buffer));
+	buffer.record.magic = CONFIG_RECORD_MAGIC;
+	buffer.record.version = CONFIG_RECORD_VERSION;
+	buffer.record.length = sizeof(STATION_Config);
+	buffer.record.sequence = sequence;
+	buffer.record.config = test_defaults;
+	buffer.record.config.station_address = station_address;
+	buffer.record.crc = CRC16((uint8_t *)&buffer.record, offsetof(CONFIG_Record, crc));
+
+	EEPROM_Write(TEST_SlotOffset(slot), buffer.words, CONFIG_SLOT_SIZE);
+}
+
+static void TEST_ReadSlot(uint8_t slot, TEST_Slot *buffer)
+{
+	EEPROM_Read(TEST_SlotOffset(slot), buffer->words, CONFIG_SLOT_SIZE);
+}
+
+// Has to run first, while the module state is still the one after reset
+static void test_first_boot_empty_store()
+{
+	TEST_Slot slot;
+
+	remove(TEST_EEPROM_PATH);
+	EEPROM_FILE_Open(TEST_EEPROM_PATH);
+
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_NOT_FOUND);
+
+	CONFIG_init();
+	TEST_CHECK_EQ(CONFIG_Get()->station_address, MODBUS_STATION_ADDRESS);
+	TEST_CHECK_EQ(CONFIG_Get()->enable_mask, (1 << CONFIG_SENSOR_COUNT) - 1);
+	TEST_CHECK_EQ(host_adc_sample_time, CONFIG_ADC_SAMPLE_TIME_MAX);
+	TEST_CHECK_EQ(EEPROM_FILE_WordWrites(), 0);
+	test_defaults = *CONFIG_Get();
+
+	// First save starts the rotation at slot 0
+	TEST_CHECK_EQ(CONFIG_Save(), CONFIG_OK);
+	TEST_ReadSlot(0, &slot);
+	TEST_CHECK_EQ(slot.record.magic, CONFIG_RECORD_MAGIC);
+	TEST_CHECK_EQ(slot.record.sequence, 1);
+
+	EEPROM_FILE_Close();
+}
+
+static void test_load_newest_valid_slot()
+{
+	remove(TEST_EEPROM_PATH);
+	EEPROM_FILE_Open(TEST_EEPROM_PATH);
+
+	TEST_WriteSlot(2, 5, 0x20);
+	TEST_WriteSlot(5, 9, 0x21);
+	TEST_WriteSlot(6, 7, 0x22);
+
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_OK);
+	TEST_CHECK_EQ(CONFIG_Get()->station_address, 0x21);
+
+	// The next save follows the loaded slot and continues its sequence
+	TEST_Slot slot;
+	TEST_CHECK_EQ(CONFIG_Save(), CONFIG_OK);
+	TEST_ReadSlot(6, &slot);
+	TEST_CHECK_EQ(slot.record.sequence, 10);
+	TEST_CHECK_EQ(slot.record.config.station_address, 0x21);
+
+	EEPROM_FILE_Close();
+}
+
+static void test_crc_corrupted_slot_skipped()
+{
+	TEST_Slot slot;
+
+	remove(TEST_EEPROM_PATH);
+	EEPROM_FILE_Open(TEST_EEPROM_PATH);
+
+	TEST_WriteSlot(3, 11, 0x30);
+	TEST_WriteSlot(4, 12, 0x31);
+
+	// Flip one bit of the newest record's payload, as a torn write would
+	TEST_ReadSlot(4, &slot);
+	slot.record.config.sensor[0].interval_ms ^= 0x0100;
+	EEPROM_Write(TEST_SlotOffset(4), slot.words, CONFIG_SLOT_SIZE);
+
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_OK);
+	TEST_CHECK_EQ(CONFIG_Get()->station_address, 0x30);
+
+	// A store with nothing but corrupted records is treated as empty
+	TEST_ReadSlot(3, &slot);
+	slot.record.crc ^= 1;
+	EEPROM_Write(TEST_SlotOffset(3), slot.words, CONFIG_SLOT_SIZE);
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_NOT_FOUND);
+
+	EEPROM_FILE_Close();
+}
+
+static void test_rotation_all_slots()
+{
+	TEST_Slot slot;
+	STATION_Config config;
+
+	remove(TEST_EEPROM_PATH);
+	EEPROM_FILE_Open(TEST_EEPROM_PATH);
+
+	TEST_WriteSlot(CONFIG_SLOT_COUNT - 1, 100, 0x40);
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_OK);
+
+	for (uint32_t i = 0; i <= CONFIG_SLOT_COUNT; ++i)
+	{
+		uint8_t expected_slot = i % CONFIG_SLOT_COUNT;
+
+		config = *CONFIG_Get();
+		config.station_address = 0x50 + i;
+		TEST_CHECK_EQ(CONFIG_Apply(&config), CONFIG_OK);
+		TEST_CHECK_EQ(CONFIG_Save(), CONFIG_OK);
+
+		TEST_ReadSlot(expected_slot, &slot);
+		TEST_CHECK_EQ(slot.record.sequence, 101 + i);
+		TEST_CHECK_EQ(slot.record.config.station_address, 0x50 + i);
+
+		// Every save reloads as the newest record
+		TEST_CHECK_EQ(CONFIG_Load(), CONFIG_OK);
+		TEST_CHECK_EQ(CONFIG_Get()->station_address, 0x50 + i);
+	}
+
+	// After a full turn every slot holds one of the last CONFIG_SLOT_COUNT saves
+	for (uint8_t i = 0; i < CONFIG_SLOT_COUNT; ++i)
+	{
+		TEST_ReadSlot(i, &slot);
+		TEST_CHECK(slot.record.sequence > 101);
+		TEST_CHECK(slot.record.sequence <= 101 + CONFIG_SLOT_COUNT);
+	}
+
+	EEPROM_FILE_Close();
+}
+
+// A save request only marks the config, the slot is written by CONFIG_Process()
+static void test_deferred_save_status()
+{
+	STATION_Config config;
+	TEST_Slot slot;
+	uint32_t writes;
+
+	remove(TEST_EEPROM_PATH);
+	EEPROM_FILE_Open(TEST_EEPROM_PATH);
+
+	TEST_WriteSlot(0, 20, 0x60);
+	TEST_CHECK_EQ(CONFIG_Load(), CONFIG_OK);
+
+	config = *CONFIG_Get();
+	config.station_address = 0x61;
+	TEST_CHECK_EQ(CONFIG_Apply(&config), CONFIG_OK);
+
+	writes = EEPROM_FILE_WordWrites();
+	CONFIG_RequestSave();
+	TEST_CHECK(CONFIG_SavePending());
+	TEST_CHECK_EQ(CONFIG_GetSaveState(), CONFIG_SAVE_PENDING);
+	TEST_CHECK_EQ(EEPROM_FILE_WordWrites(), writes);
+
+	CONFIG_Process();
+	TEST_CHECK(!CONFIG_SavePending());
+	TEST_CHECK_EQ(CONFIG_GetSaveState(), CONFIG_SAVE_DONE);
+	TEST_ReadSlot(1, &slot);
+	TEST_CHECK_EQ(slot.record.sequence, 21);
+	TEST_CHECK_EQ(slot.record.config.station_address, 0x61);
+
+	// Nothing pending, nothing written
+	writes = EEPROM_FILE_WordWrites();
+	CONFIG_Process();
+	TEST_CHECK_EQ(EEPROM_FILE_WordWrites(), writes);
+
+	// A timed out write is reported, not retried
+	EEPROM_FILE_FailWrites(1);
+	CONFIG_RequestSave();
+	CONFIG_Process();
+	TEST_CHECK_EQ(CONFIG_GetSaveState(), CONFIG_SAVE_FAILED);
+	TEST_CHECK(!CONFIG_SavePending());
+
+	EEPROM_FILE_Close();
+}
+
+int main()
+{
+	TEST_RUN(test_first_boot_empty_store);
+	TEST_RUN(test_load_newest_valid_slot);
+	TEST_RUN(test_crc_corrupted_slot_skipped);
+	TEST_RUN(test_rotation_all_slots);
+	TEST_RUN(test_deferred_save_status);
+
+	remove(TEST_EEPROM_PATH);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,123 @@
+/*
+ * test_convert.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "test.h"
+#include "convert.h"
+#include <math.h>
+#include <stdlib.h>
+
+// LMT84 datasheet transfer function, T in C, result in 0.1 mV
+static double TEST_Lmt84Dmv(double t)
+{
+	return 10.0 * (870.6 - 5.506 * (t - 30.0) - 0.00176 * (t - 30.0) * (t - 30.0));
+}
+
+// Fit used by the master application, V in volts, result in 0.1 lux
+static double TEST_LuxDlx(double v)
+{
+	return 10.0 * 1.9634 * exp(2.1281 * v);
+}
+
+static void test_adc_to_voltage()
+{
+	TEST_CHECK_EQ(CONVERT_AdcToVoltage(0, 3300), 0);
+	TEST_CHECK_EQ(CONVERT_AdcToVoltage(32768, 3300), 16500);
+	TEST_CHECK_EQ(CONVERT_AdcToVoltage(65520, 3000), 29992);
+}
+
+static void test_vdda_from_vrefint()
+{
+	// VREFINT_CAL is 12-bit at 3.0 V, the measurement is on the 16-bit scale
+	TEST_CHECK_EQ(CONVERT_Vdda(1670, 1670 * 16), 3000);
+	TEST_CHECK_EQ(CONVERT_Vdda(1670, 1670 * 16 * 3000 / 3300), 3300);
+	TEST_CHECK_EQ(CONVERT_Vdda(1670, 0), CONVERT_VDDA_NOMINAL_MV);
+}
+
+static void test_mcu_temperature_calibration_points()
+{
+	const uint16_t cal1 = 680, cal2 = 900;
+
+	TEST_CHECK_EQ(CONVERT_McuTemperature(cal1, cal2, cal1 * 16, 3000), CONVERT_TS_CAL1_CC);
+	TEST_CHECK_EQ(CONVERT_McuTemperature(cal1, cal2, cal2 * 16, 3000), CONVERT_TS_CAL2_CC);
+	TEST_CHECK_EQ(CONVERT_McuTemperature(cal1, cal2, (cal1 + cal2) * 8, 3000), 7000);
+
+	// The same die temperature read with a 3.3 V supply gives a lower code
+	TEST_CHECK_EQ(CONVERT_McuTemperature(cal1, cal2, cal1 * 16 * 3000 / 3300, 3300), CONVERT_TS_CAL1_CC);
+}
+
+static void test_lmt84_table_endpoints()
+{
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(12998), -5000);
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(14000), -5000);
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(1845), 15000);
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(0), 15000);
+
+	// Inner table points land on whole 10 C steps
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(8706), 3000);
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature(7598), 5000);
+}
+
+static void test_lmt84_interpolation()
+{
+	int16_t previous = -5000;
+
+	// Halfway between the 30 C and 40 C points
+	TEST_CHECK_EQ(CONVERT_LMT84Temperature((8706 + 8154) / 2), 3500);
+
+	// Within 0.05 C of the transfer function over the whole range
+	for (int t_cc = -5000; t_cc <= 15000; t_cc += 25)
+	{
+		uint32_t voltage = (uint32_t)lround(TEST_Lmt84Dmv(t_cc / 100.0));
+		int16_t t = CONVERT_LMT84Temperature(voltage);
+
+		TEST_CHECK(abs(t - t_cc) <= 5);
+		TEST_CHECK(t >= previous);
+		previous = t;
+	}
+}
+
+static void test_lux_table_endpoints()
+{
+	TEST_CHECK_EQ(CONVERT_NSL19M51Lux(0), 20);
+	TEST_CHECK_EQ(CONVERT_NSL19M51Lux((CONVERT_LUX_TABLE_SIZE - 1) * CONVERT_LUX_STEP_DMV), 22026);
+	TEST_CHECK_EQ(CONVERT_NSL19M51Lux(36000), 22026);
+
+	// A grid point, 0.5 V
+	TEST_CHECK_EQ(CONVERT_NSL19M51Lux(5000), 57);
+}
+
+static void test_lux_interpolation()
+{
+	uint16_t previous = 0;
+
+	// Halfway between the 0.50 V and 0.55 V points: (569 + 633) / 2 = 601
+	TEST_CHECK_EQ(CONVERT_NSL19M51Lux(5250), 60);
+
+	// Within 0.3 % (or one count) of the fit, 1 mV steps up to 3.3 V
+	for (uint32_t voltage = 0; voltage <= 33000; voltage += 10)
+	{
+		double expected = TEST_LuxDlx(voltage / 10000.0);
+		uint16_t lux = CONVERT_NSL19M51Lux(voltage);
+
+		TEST_CHECK(fabs(lux - expected) <= 1.0 || fabs(lux - expected) <= expected * 0.003);
+		TEST_CHECK(lux >= previous);
+		previous = lux;
+	}
+}
+
+int main()
+{
+	TEST_RUN(test_adc_to_voltage);
+	TEST_RUN(test_vdda_from_vrefint);
+	TEST_RUN(test_mcu_temperature_calibration_points);
+	TEST_RUN(test_lmt84_table_endpoints);
+	TEST_RUN(test_lmt84_interpolation);
+	TEST_RUN(test_lux_table_endpoints);
+	TEST_RUN(test_lux_interpolation);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,182 @@
+/*
+ * test_filter.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "test.h"
+#include "filter.h"
+
+#define TEST_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// Runs a recorded input vector through a fresh pipeline and compares every output
+static void TEST_Vector(const FILTER_Config *config, const int32_t *input, const int32_t *expected, uint32_t count)
+{
+	FILTER_State state;
+
+	FILTER_Reset(&state, config);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		int32_t output = FILTER_Apply(&state, config, input[i]);
+
+		if (output != expected[i])
+		{
+			printf("  sample %u: got %d, expected %d\n", i, output, expected[i]);
+		}
+		TEST_CHECK_EQ(output, expected[i]);
+	}
+}
+
+// LMT84 readings in 0.01 C with single-sample spikes from a noisy cable
+static void test_median3_rejects_spikes()
+{
+	const FILTER_Config config = { .median = 3 };
+	static const int32_t input[] = { 2150, 2151, 2152, 9999, 2153, 2154, -500, 2155, 2156 };
+	static const int32_t expected[] = { 2150, 2151, 2151, 2152, 2153, 2154, 2153, 2154, 2155 };
+
+	TEST_Vector(&config, input, expected, TEST_COUNT(input));
+}
+
+// Two spikes in a row need the 5-sample window
+static void test_median5_rejects_double_spike()
+{
+	const FILTER_Config config = { .median = 5 };
+	static const int32_t input[] = { 2150, 2152, 2151, 2153, 9999, 9998, 2149, 2150, -400, 2152 };
+	static const int32_t expected[] = { 2150, 2152, 2151, 2152, 2152, 2153, 2153, 2153, 2150, 2150 };
+
+	TEST_Vector(&config, input, expected, TEST_COUNT(input));
+}
+
+// Step response with alpha = 1/4, the first sample seeds the average
+static void test_ema_step_response()
+{
+	const FILTER_Config config = { .ema_shift = 2 };
+	static const int32_t input[] = { 0, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000 };
+	static const int32_t expected[] = { 0, 250, 438, 578, 684, 763, 822, 866, 900, 925, 944, 958 };
+
+	TEST_Vector(&config, input, expected, TEST_COUNT(input));
+}
+
+// The average settles exactly on the input, for rising and falling steps
+static void test_ema_settles_without_offset()
+{
+	static const int32_t steps[] = { 1000, -1000, 1, -1 };
+	FILTER_State state;
+
+	for (uint8_t shift = 1; shift <= FILTER_EMA_SHIFT_MAX; ++shift)
+	{
+		const FILTER_Config config = { .ema_shift = shift };
+
+		for (uint32_t s = 0; s < TEST_COUNT(steps); ++s)
+		{
+			int32_t output = 0;
+			uint32_t settled_at = 0;
+
+			FILTER_Reset(&state, &config);
+			FILTER_Apply(&state, &config, 0);
+
+			// 2^shift samples per time constant, 20 of them is ample
+			for (uint32_t i = 1; i <= 20u << shift; ++i)
+			{
+				output = FILTER_Apply(&state, &config, steps[s]);
+				if (output != steps[s])
+				{
+					settled_at = i;
+				}
+			}
+
+			TEST_CHECK_EQ(output, steps[s]);
+			TEST_CHECK(settled_at < (12u << shift));
+		}
+	}
+}
+
+// Window of 4 on 1 ... 10: partial windows first, then the oldest sample leaves
+static void test_boxcar_wraps()
+{
+	const FILTER_Config config = { .boxcar = 4 };
+	static const int32_t input[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	static const int32_t expected[] = { 1, 1, 2, 2, 3, 4, 5, 6, 7, 8 };
+
+	TEST_Vector(&config, input, expected, TEST_COUNT(input));
+}
+
+// Many wraps must not leave a residue in the running sum
+static void test_boxcar_sum_after_many_wraps()
+{
+	const FILTER_Config config = { .boxcar = FILTER_BOXCAR_MAX };
+	FILTER_State state;
+	int32_t output = 0;
+
+	FILTER_Reset(&state, &config);
+	for (int32_t i = 0; i < 1000; ++i)
+	{
+		FILTER_Apply(&state, &config, (i * 7919) % 4096 - 2048);
+	}
+
+	for (int32_t i = 0; i < FILTER_BOXCAR_MAX; ++i)
+	{
+		output = FILTER_Apply(&state, &config, -1234);
+	}
+
+	TEST_CHECK_EQ(output, -1234);
+	TEST_CHECK_EQ(state.boxcar_sum, -1234 * FILTER_BOXCAR_MAX);
+}
+
+// All three stages on a recorded trace, spikes never reach the output
+static void test_full_pipeline()
+{
+	const FILTER_Config config = { .median = 3, .ema_shift = 2, .boxcar = 4 };
+	static const int32_t input[] = {
+		2210, 2212, 2209, 2215, 2211, 6500, 2213, 2216,
+		2214, 2218, 2217, 2219, -300, 2221, 2220, 2223
+	};
+	static const int32_t expected[] = {
+		2210, 2210, 2210, 2210, 2210, 2211, 2211, 2212,
+		2212, 2213, 2213, 2214, 2215, 2216, 2216, 2217
+	};
+
+	TEST_Vector(&config, input, expected, TEST_COUNT(input));
+}
+
+// Stages that are off pass samples through untouched
+static void test_disabled_stages_pass_through()
+{
+	const FILTER_Config config = { .median = 1, .ema_shift = 0, .boxcar = 1 };
+	static const int32_t input[] = { 5, -7, 9999, 0 };
+
+	TEST_Vector(&config, input, input, TEST_COUNT(input));
+}
+
+// A new window length restarts the pipeline instead of mixing old samples in
+static void test_config_change_restarts()
+{
+	FILTER_Config config = { .boxcar = 4 };
+	FILTER_State state;
+
+	FILTER_Reset(&state, &config);
+	for (int i = 0; i < 4; ++i)
+	{
+		FILTER_Apply(&state, &config, 100);
+	}
+
+	config.boxcar = 2;
+	TEST_CHECK_EQ(FILTER_Apply(&state, &config, 300), 300);
+	TEST_CHECK_EQ(FILTER_Apply(&state, &config, 100), 200);
+}
+
+int main()
+{
+	TEST_RUN(test_median3_rejects_spikes);
+	TEST_RUN(test_median5_rejects_double_spike);
+	TEST_RUN(test_ema_step_response);
+	TEST_RUN(test_ema_settles_without_offset);
+	TEST_RUN(test_boxcar_wraps);
+	TEST_RUN(test_boxcar_sum_after_many_wraps);
+	TEST_RUN(test_full_pipeline);
+	TEST_RUN(test_disabled_stages_pass_through);
+	TEST_RUN(test_config_change_restarts);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,122 @@
+/*
+ * test_oversample.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "test.h"
+#include "oversample.h"
+
+#define TEST_SCALE (1 << (OVERSAMPLE_OUTPUT_BITS - OVERSAMPLE_INPUT_BITS))
+
+// Synthetic 12-bit source: a level in 1/4 LSB steps, dithered by repeating
+// the two neighbouring codes in the right proportion
+static uint16_t TEST_Source(uint32_t level_q2, uint32_t index)
+{
+	return (level_q2 >> 2) + ((index & 3) < (level_q2 & 3));
+}
+
+static void test_no_oversampling_scales_to_16_bits()
+{
+	OVERSAMPLE_Channel channel;
+
+	OVERSAMPLE_Init(&channel, 0);
+	TEST_CHECK_EQ(channel.ready, 0);
+
+	TEST_CHECK_EQ(OVERSAMPLE_Add(&channel, 4095), 1);
+	TEST_CHECK_EQ(channel.result, 65520);
+	TEST_CHECK_EQ(channel.ready, 1);
+
+	TEST_CHECK_EQ(OVERSAMPLE_Add(&channel, 1), 1);
+	TEST_CHECK_EQ(channel.result, TEST_SCALE);
+}
+
+static void test_block_completes_every_2_pow_log2_samples()
+{
+	OVERSAMPLE_Channel channel;
+
+	for (uint8_t log2 = 0; log2 <= OVERSAMPLE_LOG2_MAX; ++log2)
+	{
+		uint32_t blocks = 0;
+
+		OVERSAMPLE_Init(&channel, log2);
+		for (uint32_t i = 1; i <= 3u << log2; ++i)
+		{
+			uint8_t done = OVERSAMPLE_Add(&channel, 100);
+
+			TEST_CHECK_EQ(done, (i % (1u << log2)) == 0);
+			blocks += done;
+		}
+
+		TEST_CHECK_EQ(blocks, 3);
+		TEST_CHECK_EQ(channel.result, 100 * TEST_SCALE);
+	}
+}
+
+static void test_log2_clamped()
+{
+	OVERSAMPLE_Channel channel;
+
+	OVERSAMPLE_Init(&channel, OVERSAMPLE_LOG2_MAX + 3);
+	TEST_CHECK_EQ(channel.log2, OVERSAMPLE_LOG2_MAX);
+}
+
+// Averaging a dithered source recovers the level between two codes
+static void test_dithered_level_resolved()
+{
+	OVERSAMPLE_Channel channel;
+	static const uint32_t levels_q2[] = { 4001, 4002, 4003, 10, 16379 };
+
+	for (uint32_t l = 0; l < sizeof(levels_q2) / sizeof(levels_q2[0]); ++l)
+	{
+		// 4 samples already cover one dither period
+		for (uint8_t log2 = 2; log2 <= OVERSAMPLE_LOG2_MAX; log2 += 2)
+		{
+			OVERSAMPLE_Init(&channel, log2);
+			for (uint32_t i = 0; i < (1u << log2); ++i)
+			{
+				OVERSAMPLE_Add(&channel, TEST_Source(levels_q2[l], i));
+			}
+
+			TEST_CHECK_EQ(channel.result, levels_q2[l] * TEST_SCALE / 4);
+		}
+	}
+
+	// One sample per block cannot see below one code
+	OVERSAMPLE_Init(&channel, 0);
+	OVERSAMPLE_Add(&channel, TEST_Source(4001, 3));
+	TEST_CHECK_EQ(channel.result, 1000 * TEST_SCALE);
+}
+
+static void test_full_scale_256_samples_no_overflow()
+{
+	OVERSAMPLE_Channel channel;
+
+	OVERSAMPLE_Init(&channel, OVERSAMPLE_LOG2_MAX);
+	for (uint32_t i = 0; i < (1u << OVERSAMPLE_LOG2_MAX); ++i)
+	{
+		OVERSAMPLE_Add(&channel, 4095);
+	}
+
+	TEST_CHECK_EQ(channel.result, 65520);
+
+	// The accumulator restarts after each block
+	for (uint32_t i = 0; i < (1u << OVERSAMPLE_LOG2_MAX); ++i)
+	{
+		OVERSAMPLE_Add(&channel, 0);
+	}
+
+	TEST_CHECK_EQ(channel.result, 0);
+}
+
+int main()
+{
+	TEST_RUN(test_no_oversampling_scales_to_16_bits);
+	TEST_RUN(test_block_completes_every_2_pow_log2_samples);
+	TEST_RUN(test_log2_clamped);
+	TEST_RUN(test_dithered_level_resolved);
+	TEST_RUN(test_full_scale_256_samples_no_overflow);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,256 @@
+/*
+ * test_timer_wheel.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: lauri
+ */
+
+#include "test.h"
+#include "timer_wheel.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Simulated clock, advanced one tick per TWHEEL_Process() call
+static uint32_t test_clock;
+
+typedef struct TEST_Timer {
+	TWHEEL_Id id;
+	uint32_t due; // Tick the next callback is expected on
+	uint32_t period;
+	uint32_t fired;
+	uint32_t wrong_tick;
+	uint32_t stop_after; // Cancels itself from the callback after this many, 0 = never
+} TEST_Timer;
+
+static void TEST_Callback(void *arg)
+{
+	TEST_Timer *timer = arg;
+
+	if (test_clock != timer->due)
+	{
+		printf("  timer %u fired at %u, due %u\n", timer->id, test_clock, timer->due);
+		timer->wrong_tick++;
+	}
+
+	timer->fired++;
+	timer->due += timer->period;
+
+	if (timer->stop_after != 0 && timer->fired == timer->stop_after)
+	{
+		TWHEEL_Cancel(timer->id);
+	}
+}
+
+static void TEST_Start(TEST_Timer *timer, uint32_t delay, uint32_t period)
+{
+	timer->id = TWHEEL_Create(TEST_Callback, timer);
+	timer->due = test_clock + (delay ? delay : 1);
+	timer->period = period;
+	timer->fired = 0;
+	timer->wrong_tick = 0;
+	timer->stop_after = 0;
+	TWHEEL_Start(timer->id, delay, period);
+}
+
+static void TEST_Run(uint32_t ticks)
+{
+	while (ticks--)
+	{
+		test_clock++;
+		TWHEEL_Process(test_clock);
+	}
+}
+
+// One-shot delays on both sides of every level boundary fire on their exact tick
+static void test_level_boundaries()
+{
+	static const uint32_t delays[] = {
+		0, 1, 63, 64, 65, 127, 4095, 4096, 4097, 8191, 262143
+	};
+	// Start phases that put the first cascade of each level right after the start
+	static const uint32_t starts[] = { 0, 62, 63, 4094, 4095, 262143, 0xFFFFFFFFu - 70 };
+	TEST_Timer timers[sizeof(delays) / sizeof(delays[0])];
+
+	for (uint32_t s = 0; s < sizeof(starts) / sizeof(starts[0]); ++s)
+	{
+		test_clock = starts[s];
+		TWHEEL_Init(test_clock);
+
+		for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+		{
+			TEST_Start(&timers[i], delays[i], 0);
+		}
+
+		TEST_Run(262144);
+
+		for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+		{
+			TEST_CHECK_EQ(timers[i].fired, 1);
+			TEST_CHECK_EQ(timers[i].wrong_tick, 0);
+			TEST_CHECK(!TWHEEL_Active(timers[i].id));
+		}
+	}
+}
+
+// Delays beyond the wheel's 262143 ticks wait in the last level and are
+// re-filed until they are in range, they still fire on time
+static void test_long_delays_clamped_and_refiled()
+{
+	static const uint32_t delays[] = { 262144, 262145, 300000, 524288, 1000000 };
+	TEST_Timer timers[sizeof(delays) / sizeof(delays[0])];
+
+	test_clock = 0xFFFFFFFFu - 500000; // The run crosses the 32-bit wrap
+	TWHEEL_Init(test_clock);
+
+	for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+	{
+		TEST_Start(&timers[i], delays[i], 0);
+	}
+
+	TEST_Run(262143);
+	for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+	{
+		TEST_CHECK_EQ(timers[i].fired, 0);
+		TEST_CHECK(TWHEEL_Active(timers[i].id));
+	}
+
+	TEST_Run(1000000 - 262143);
+	for (uint32_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+	{
+		TEST_CHECK_EQ(timers[i].fired, 1);
+		TEST_CHECK_EQ(timers[i].wrong_tick, 0);
+	}
+}
+
+// A periodic timer re-arms itself with a steady phase, also across levels
+static void test_periodic_rearm()
+{
+	TEST_Timer fast, slow, self_stop;
+
+	test_clock = 1000;
+	TWHEEL_Init(test_clock);
+
+	TEST_Start(&fast, 50, 100);
+	TEST_Start(&slow, 5000, 70000);
+	TEST_Start(&self_stop, 10, 10);
+	self_stop.stop_after = 3;
+
+	TEST_Run(300000);
+
+	TEST_CHECK_EQ(fast.fired, (300000 - 50) / 100 + 1);
+	TEST_CHECK_EQ(fast.wrong_tick, 0);
+	TEST_CHECK(TWHEEL_Active(fast.id));
+
+	TEST_CHECK_EQ(slow.fired, (300000 - 5000) / 70000 + 1);
+	TEST_CHECK_EQ(slow.wrong_tick, 0);
+
+	// Cancelled from its own callback, after the re-arm
+	TEST_CHECK_EQ(self_stop.fired, 3);
+	TEST_CHECK(!TWHEEL_Active(self_stop.id));
+}
+
+// A late TWHEEL_Process() catches up tick by tick, callbacks run in order
+static uint8_t test_order[8];
+static uint8_t test_order_count;
+
+static void TEST_OrderCallback(void *arg)
+{
+	if (test_order_count < sizeof(test_order))
+	{
+		test_order[test_order_count] = (uint8_t)(uintptr_t)arg;
+	}
+	test_order_count++;
+}
+
+static void test_catch_up_in_order()
+{
+	TWHEEL_Id periodic;
+
+	test_clock = 77;
+	TWHEEL_Init(test_clock);
+	test_order_count = 0;
+
+	TWHEEL_Start(TWHEEL_Create(TEST_OrderCallback, (void *)3), 5000, 0);
+	TWHEEL_Start(TWHEEL_Create(TEST_OrderCallback, (void *)1), 30, 0);
+	periodic = TWHEEL_Create(TEST_OrderCallback, (void *)2);
+	TWHEEL_Start(periodic, 2000, 2000);
+
+	test_clock += 6500;
+	TWHEEL_Process(test_clock);
+
+	// 30, 2000, 4000, 5000, 6000
+	TEST_CHECK_EQ(test_order_count, 5);
+	TEST_CHECK_EQ(test_order[0], 1);
+	TEST_CHECK_EQ(test_order[1], 2);
+	TEST_CHECK_EQ(test_order[2], 2);
+	TEST_CHECK_EQ(test_order[3], 3);
+	TEST_CHECK_EQ(test_order[4], 2);
+	TEST_CHECK(TWHEEL_Active(periodic));
+}
+
+static void test_pool_and_cancel()
+{
+	TEST_Timer timers[TWHEEL_MAX_TIMERS];
+
+	test_clock = 0;
+	TWHEEL_Init(test_clock);
+
+	for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+	{
+		TEST_Start(&timers[i], 100 + i, 0);
+		TEST_CHECK(timers[i].id != TWHEEL_INVALID);
+	}
+
+	TEST_CHECK_EQ(TWHEEL_Create(TEST_Callback, NULL), TWHEEL_INVALID);
+
+	TWHEEL_Cancel(timers[3].id);
+	TWHEEL_Cancel(timers[3].id); // Twice is harmless
+	TEST_Run(200);
+
+	for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+	{
+		TEST_CHECK_EQ(timers[i].fired, i == 3 ? 0 : 1);
+	}
+}
+
+// Random mix of one-shot and periodic timers of every range around the wrap
+static void test_random_timers()
+{
+	TEST_Timer timers[TWHEEL_MAX_TIMERS];
+
+	srand(1);
+
+	for (int round = 0; round < 20; ++round)
+	{
+		test_clock = 0xFFFFFFFFu - (uint32_t)(rand() % 4000000);
+		TWHEEL_Init(test_clock);
+
+		for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+		{
+			int range = rand() % 4;
+			uint32_t delay = (range == 0) ? rand() % 70 : (range == 1) ? rand() % 5000 : (range == 2) ? rand() % 300000 : rand() % 3000000;
+
+			TEST_Start(&timers[i], delay, (i % 3 == 0) ? 1 + rand() % 1000 : 0);
+		}
+
+		TEST_Run(3100000);
+
+		for (int i = 0; i < TWHEEL_MAX_TIMERS; ++i)
+		{
+			TEST_CHECK(timers[i].fired > 0);
+			TEST_CHECK_EQ(timers[i].wrong_tick, 0);
+		}
+	}
+}
+
+int main()
+{
+	TEST_RUN(test_level_boundaries);
+	TEST_RUN(test_long_delays_clamped_and_refiled);
+	TEST_RUN(test_periodic_rearm);
+	TEST_RUN(test_catch_up_in_order);
+	TEST_RUN(test_pool_and_cancel);
+	TEST_RUN(test_random_timers);
+
+	return TEST_RESULT();
+}